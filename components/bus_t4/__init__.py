@@ -1 +1,175 @@
+import esphome.codegen as cg
+import esphome.config_validation as cv
+from esphome import automation
+from esphome.components import cover
+from esphome.const import CONF_DATA, CONF_ID, CONF_NAME, CONF_PRIORITY, CONF_TIMEOUT, CONF_TRIGGER_ID, CONF_VALUE
 
+
+bus_t4_ns = cg.esphome_ns.namespace('bus_t4')
+Nice = bus_t4_ns.class_('NiceBusT4', cover.Cover, cg.Component)
+
+CONF_BUS_T4_ID = 'bus_t4_id'
+CONF_REGISTER = 'register'
+CONF_LENGTH = 'length'
+CONF_COMMAND = 'command'
+CONF_FIX_CRC = 'fix_crc'
+CONF_ON_ERROR = 'on_error'
+CONF_ON_TIMEOUT = 'on_timeout'
+CONF_ON_VALUE = 'on_value'
+
+TxPriority = bus_t4_ns.enum('tx_priority')
+TX_PRIORITIES = {
+    'high': TxPriority.TX_HIGH,
+    'normal': TxPriority.TX_NORMAL,
+    'low': TxPriority.TX_LOW,
+}
+
+# control_cmd
+COMMANDS = {
+    'sbs': 0x01, 'stop': 0x02, 'open': 0x03, 'close': 0x04,
+    'p_opn1': 0x05, 'p_opn2': 0x06, 'p_opn3': 0x07, 'p_opn4': 0x0B, 'p_opn5': 0x0C, 'p_opn6': 0x0D,
+    'unlk_opn': 0x19, 'cls_lock': 0x0E, 'lock': 0x0F, 'unlck_cls': 0x1A, 'unlock': 0x10,
+    'light_timer': 0x11, 'light_sw': 0x12,
+    'host_sbs': 0x13, 'host_opn': 0x14, 'host_cls': 0x15, 'slave_sbs': 0x16, 'slave_opn': 0x17, 'slave_cls': 0x18,
+    'auto_on': 0x1B, 'auto_off': 0x1C,
+}
+
+# gate status of STA, RUN and INF_STATUS frames
+STATUSES = {
+    'opening': 0x02, 'closing': 0x03, 'opened': 0x04, 'closed': 0x05,
+    'endtime': 0x06, 'stopped': 0x08, 'part_opened': 0x10,
+}
+
+
+def code_of(names):
+    def validator(value):
+        if isinstance(value, int):
+            return cv.hex_uint8_t(value)
+        return names[cv.one_of(*names, lower=True)(value)]
+    return validator
+
+
+# schema for the platforms attached to a bus_t4 cover
+BUS_T4_CHILD_SCHEMA = cv.Schema({
+    cv.GenerateID(CONF_BUS_T4_ID): cv.use_id(Nice),
+})
+
+SendCommandAction = bus_t4_ns.class_('SendCommandAction', automation.Action)
+SetRegisterAction = bus_t4_ns.class_('SetRegisterAction', automation.Action)
+GetRegisterAction = bus_t4_ns.class_('GetRegisterAction', automation.Action)
+RawAction = bus_t4_ns.class_('RawAction', automation.Action)
+RunSequenceAction = bus_t4_ns.class_('RunSequenceAction', automation.Action)
+StopSequenceAction = bus_t4_ns.class_('StopSequenceAction', automation.Action)
+
+
+# actions that wait for the answer of the device; the rest of the automation is skipped when on_error or
+# on_timeout run instead
+AWAIT_SCHEMA = cv.Schema({
+    cv.GenerateID(): cv.use_id(Nice),
+    cv.Optional(CONF_ON_ERROR): automation.validate_automation({  # 'error' byte of the answer
+        cv.GenerateID(CONF_TRIGGER_ID): cv.declare_id(automation.Trigger.template(cg.uint8)),
+    }),
+    cv.Optional(CONF_ON_TIMEOUT): automation.validate_automation({
+        cv.GenerateID(CONF_TRIGGER_ID): cv.declare_id(automation.Trigger.template()),
+    }),
+})
+AWAIT_TIMEOUT_SCHEMA = AWAIT_SCHEMA.extend({
+    cv.Optional(CONF_TIMEOUT, default='2s'): cv.positive_time_period_milliseconds,  # after the frame is sent
+})
+
+
+def await_to_code(var, config):
+    yield cg.register_parented(var, config[CONF_ID])
+    if CONF_TIMEOUT in config:
+        cg.add(var.set_timeout(config[CONF_TIMEOUT]))
+    for conf in config.get(CONF_ON_ERROR, []):
+        trigger = cg.new_Pvariable(conf[CONF_TRIGGER_ID])
+        cg.add(var.register_error_trigger(trigger))
+        yield automation.build_automation(trigger, [(cg.uint8, 'error')], conf)
+    for conf in config.get(CONF_ON_TIMEOUT, []):
+        trigger = cg.new_Pvariable(conf[CONF_TRIGGER_ID])
+        cg.add(var.register_timeout_trigger(trigger))
+        yield automation.build_automation(trigger, [], conf)
+
+
+@automation.register_action('bus_t4.send_command', SendCommandAction, AWAIT_TIMEOUT_SCHEMA.extend({
+    cv.Required(CONF_COMMAND): cv.templatable(code_of(COMMANDS)),
+}))
+def send_command_to_code(config, action_id, template_arg, args):
+    var = cg.new_Pvariable(action_id, template_arg)
+    yield from await_to_code(var, config)
+    command = yield cg.templatable(config[CONF_COMMAND], args, cg.uint8)
+    cg.add(var.set_command(command))
+    yield var
+
+
+@automation.register_action('bus_t4.get_register', GetRegisterAction, AWAIT_TIMEOUT_SCHEMA.extend({
+    cv.Required(CONF_REGISTER): cv.templatable(cv.hex_uint8_t),
+    cv.Optional(CONF_LENGTH, default=1): cv.int_range(min=1, max=4),  # value bytes
+    cv.Optional(CONF_ON_VALUE): automation.validate_automation({  # 'value', before the next action
+        cv.GenerateID(CONF_TRIGGER_ID): cv.declare_id(automation.Trigger.template(cg.uint32)),
+    }),
+}))
+def get_register_to_code(config, action_id, template_arg, args):
+    var = cg.new_Pvariable(action_id, template_arg)
+    yield from await_to_code(var, config)
+    reg = yield cg.templatable(config[CONF_REGISTER], args, cg.uint8)
+    cg.add(var.set_reg(reg))
+    cg.add(var.set_length(config[CONF_LENGTH]))
+    for conf in config.get(CONF_ON_VALUE, []):
+        trigger = cg.new_Pvariable(conf[CONF_TRIGGER_ID])
+        cg.add(var.register_value_trigger(trigger))
+        yield automation.build_automation(trigger, [(cg.uint32, 'value')], conf)
+    yield var
+
+
+@automation.register_action('bus_t4.raw', RawAction, AWAIT_TIMEOUT_SCHEMA.extend({
+    cv.Required(CONF_DATA): cv.templatable(cv.string),  # hex bytes from 0x55 to the size byte
+    cv.Optional(CONF_PRIORITY, default='normal'): cv.enum(TX_PRIORITIES, lower=True),
+    cv.Optional(CONF_FIX_CRC, default=False): cv.boolean,  # recompute sizes and checksums
+}))
+def raw_to_code(config, action_id, template_arg, args):
+    var = cg.new_Pvariable(action_id, template_arg)
+    yield from await_to_code(var, config)
+    data = yield cg.templatable(config[CONF_DATA], args, cg.std_string)
+    cg.add(var.set_data(data))
+    cg.add(var.set_priority(config[CONF_PRIORITY]))
+    cg.add(var.set_fix_crc(config[CONF_FIX_CRC]))
+    yield var
+
+
+@automation.register_action('bus_t4.set_register', SetRegisterAction, AWAIT_SCHEMA.extend({
+    cv.Required(CONF_REGISTER): cv.templatable(cv.hex_uint8_t),
+    cv.Required(CONF_VALUE): cv.templatable(cv.uint32_t),
+    cv.Optional(CONF_LENGTH, default=1): cv.int_range(min=1, max=4),  # value bytes
+}))
+def set_register_to_code(config, action_id, template_arg, args):
+    var = cg.new_Pvariable(action_id, template_arg)
+    yield from await_to_code(var, config)
+    reg = yield cg.templatable(config[CONF_REGISTER], args, cg.uint8)
+    cg.add(var.set_reg(reg))
+    value = yield cg.templatable(config[CONF_VALUE], args, cg.uint32)
+    cg.add(var.set_value(value))
+    cg.add(var.set_length(config[CONF_LENGTH]))
+    yield var
+
+
+@automation.register_action('bus_t4.run_sequence', RunSequenceAction, cv.Schema({
+    cv.GenerateID(): cv.use_id(Nice),
+    cv.Required(CONF_NAME): cv.templatable(cv.string),
+}))
+def run_sequence_to_code(config, action_id, template_arg, args):
+    var = cg.new_Pvariable(action_id, template_arg)
+    yield cg.register_parented(var, config[CONF_ID])
+    name = yield cg.templatable(config[CONF_NAME], args, cg.std_string)
+    cg.add(var.set_name(name))
+    yield var
+
+
+@automation.register_action('bus_t4.stop_sequence', StopSequenceAction, cv.Schema({
+    cv.GenerateID(): cv.use_id(Nice),
+}))
+def stop_sequence_to_code(config, action_id, template_arg, args):
+    var = cg.new_Pvariable(action_id, template_arg)
+    yield cg.register_parented(var, config[CONF_ID])
+    yield var
@@ -1,21 +1,244 @@
-#pragma once
-
-
-#include "esphome/core/automation.h"
-
-namespace esphome {
-namespace bus_t4 {
-
-template<typename... Ts> class RawCmdAction : public Action<Ts...> {
-
-  
-
-  void play(Ts... x) override {
-    }
-  
- protected:
-
-};
-
-}  // namespace bus_t4
-}  // namespace esphome
\ No newline at end of file
+#pragma once
+
+
+#include "esphome/core/automation.h"
+#include "nice-bust4.h"
+
+namespace esphome {
+namespace bus_t4 {
+
+// base of the actions that wait for the answer of the device: the rest of the automation runs once it arrives,
+// on_error or on_timeout run instead when the device refuses the request or does not answer
+template<typename... Ts> class AwaitAction : public Action<Ts...>, public Parented<NiceBusT4> {
+ public:
+  void set_timeout(uint32_t timeout) { this->timeout_ = timeout; }
+  void register_error_trigger(Trigger<uint8_t> *trigger) { this->error_triggers_.push_back(trigger); }
+  void register_timeout_trigger(Trigger<> *trigger) { this->timeout_triggers_.push_back(trigger); }
+
+  void play_complex(Ts... x) override {
+    this->num_running_++;
+    this->var_ = std::make_tuple(x...);
+    if (!this->send_([this](uint8_t result, const std::vector<uint8_t> *reply) { this->finish_(result, reply); }, x...))
+      this->finish_(AWAIT_ERROR, nullptr);  // not queued
+  }
+
+  void play(Ts... x) override { /* play_complex() does the work */ }
+
+ protected:
+  virtual bool send_(AwaitCallback &&done, Ts... x) = 0;
+  virtual void answered_(const std::vector<uint8_t> &reply) {}  // before the next action runs
+
+  void finish_(uint8_t result, const std::vector<uint8_t> *reply) {
+    if (this->num_running_ == 0)  // stopped meanwhile
+      return;
+    if (result == AWAIT_OK) {
+      if (reply != nullptr)
+        this->answered_(*reply);
+      this->play_next_tuple_(this->var_);
+      return;
+    }
+    this->num_running_--;  // the rest of the automation is skipped
+    if (result == AWAIT_TIMEOUT) {
+      for (auto *trigger : this->timeout_triggers_)
+        trigger->trigger();
+    } else {
+      uint8_t error = (reply != nullptr) ? (*reply)[13] : 0;  // 0 - refused before reaching the bus or read back wrong
+      for (auto *trigger : this->error_triggers_)
+        trigger->trigger(error);
+    }
+  }
+
+  uint32_t timeout_{2000};  // ms
+  std::tuple<Ts...> var_{};
+  std::vector<Trigger<uint8_t> *> error_triggers_;
+  std::vector<Trigger<> *> timeout_triggers_;
+};
+
+// bus_t4.send_command: continues once the drive acknowledges the command
+template<typename... Ts> class SendCommandAction : public AwaitAction<Ts...> {
+ public:
+  TEMPLATABLE_VALUE(uint8_t, command)
+
+ protected:
+  bool send_(AwaitCallback &&done, Ts... x) override {
+    return this->parent_->send_command(this->command_.value(x...), this->timeout_, std::move(done));
+  }
+};
+
+// bus_t4.set_register: continues with the next action once the drive reports the written value
+template<typename... Ts> class SetRegisterAction : public AwaitAction<Ts...> {
+ public:
+  TEMPLATABLE_VALUE(uint8_t, reg)
+  TEMPLATABLE_VALUE(uint32_t, value)
+  void set_length(uint8_t length) { this->length_ = length; }
+
+ protected:
+  // timeouts and retries are those of register writes
+  bool send_(AwaitCallback &&done, Ts... x) override {
+    this->parent_->set_register(this->reg_.value(x...), this->value_.value(x...), this->length_,
+                                [done](uint8_t result) { done(result, nullptr); });
+    return true;
+  }
+
+  uint8_t length_{1};
+};
+
+// bus_t4.get_register: on_value gets the value of the answer, then the next action runs
+template<typename... Ts> class GetRegisterAction : public AwaitAction<Ts...> {
+ public:
+  TEMPLATABLE_VALUE(uint8_t, reg)
+  void set_length(uint8_t length) { this->length_ = length; }
+  void register_value_trigger(Trigger<uint32_t> *trigger) { this->value_triggers_.push_back(trigger); }
+
+ protected:
+  bool send_(AwaitCallback &&done, Ts... x) override {
+    return this->parent_->get_register(this->reg_.value(x...), this->timeout_, std::move(done));
+  }
+  void answered_(const std::vector<uint8_t> &reply) override {
+    uint8_t len = std::min<size_t>(this->length_, reply.size() - 16);
+    uint32_t value = register_value(&reply[14], len);
+    for (auto *trigger : this->value_triggers_)
+      trigger->trigger(value);
+  }
+
+  uint8_t length_{1};
+  std::vector<Trigger<uint32_t> *> value_triggers_;
+};
+
+// bus_t4.raw: a frame in hex, continues once the addressed device answers it
+template<typename... Ts> class RawAction : public AwaitAction<Ts...> {
+ public:
+  TEMPLATABLE_VALUE(std::string, data)
+  void set_priority(uint8_t priority) { this->priority_ = priority; }
+  void set_fix_crc(bool fix_crc) { this->fix_crc_ = fix_crc; }
+
+ protected:
+  bool send_(AwaitCallback &&done, Ts... x) override {
+    return this->parent_->send_raw_cmd(this->data_.value(x...), this->priority_, this->fix_crc_, this->timeout_,
+                                       std::move(done));
+  }
+
+  uint8_t priority_{TX_NORMAL};
+  bool fix_crc_{false};
+};
+
+// bus_t4.run_sequence: starts a sequence declared on the cover, a running one is stopped
+template<typename... Ts> class RunSequenceAction : public Action<Ts...>, public Parented<NiceBusT4> {
+ public:
+  TEMPLATABLE_VALUE(std::string, name)
+
+  void play(Ts... x) override { this->parent_->run_sequence(this->name_.value(x...)); }
+};
+
+template<typename... Ts> class StopSequenceAction : public Action<Ts...>, public Parented<NiceBusT4> {
+ public:
+  void play(Ts... x) override { this->parent_->stop_sequence(); }
+};
+
+// on_sequence_end: a sequence finished all its steps (true) or failed, timed out or was stopped (false)
+class SequenceEndTrigger : public Trigger<std::string, bool> {
+ public:
+  explicit SequenceEndTrigger(NiceBusT4 *parent) {
+    parent->add_on_sequence_callback([this](const std::string &name, bool ok) { this->trigger(name, ok); });
+  }
+};
+
+// on_remote: fires on every remote control press, optionally only for one remote and/or button
+class RemoteButtonTrigger : public Trigger<uint32_t, uint8_t>, public BusT4Listener {
+ public:
+  explicit RemoteButtonTrigger(NiceBusT4 *parent) { parent->add_listener(this); }
+  void set_serial(uint32_t serial) {
+    this->serial_ = serial;
+    this->has_serial_ = true;
+  }
+  void set_button(uint8_t button) { this->button_ = button; }
+
+  void on_remote(const RemoteEvent &event) override {
+    if (this->has_serial_ && event.serial != this->serial_)
+      return;
+    if (this->button_ != 0 && event.button != this->button_)
+      return;
+    this->trigger(event.serial, event.button);
+  }
+
+ protected:
+  uint32_t serial_{0};
+  bool has_serial_{false};
+  uint8_t button_{0};  // 0 - any button
+};
+
+// on_trace: motion trace dump requested by dump_trace(), base64
+class TraceTrigger : public Trigger<std::string> {
+ public:
+  explicit TraceTrigger(NiceBusT4 *parent) {
+    parent->add_on_trace_callback([this](const std::string &trace) { this->trigger(trace); });
+  }
+};
+
+// on_register_change: value of a drive register differs from the previous reply, the first reply always fires
+class RegisterChangeTrigger : public Trigger<uint32_t, uint16_t>, public BusT4Listener {
+ public:
+  RegisterChangeTrigger(NiceBusT4 *parent, uint8_t reg, uint8_t len) : reg_(reg), len_(len) {
+    parent->watch_register(reg);
+    parent->add_listener(this);
+  }
+
+  void on_register(uint16_t address, uint8_t reg, const uint8_t *data, uint8_t len) override {
+    if ((reg != this->reg_) || (len < this->len_))
+      return;
+    uint32_t value = register_value(data, this->len_);
+    if (this->known_ && (value == this->value_))
+      return;
+    this->known_ = true;
+    this->value_ = value;
+    this->trigger(value, address);
+  }
+
+ protected:
+  uint8_t reg_;
+  uint8_t len_;  // value bytes, big-endian
+  bool known_{false};
+  uint32_t value_{0};
+};
+
+// on_status: gate status reported by a drive, in INF_STATUS replies and in RUN/STA packets
+class StatusTrigger : public Trigger<uint8_t, uint16_t>, public BusT4Listener {
+ public:
+  explicit StatusTrigger(NiceBusT4 *parent) { parent->add_listener(this); }
+  void on_status(uint16_t address, uint8_t status) override { this->trigger(status, address); }
+};
+
+// on_error: a device answered an INF request with an error
+class ErrorTrigger : public Trigger<uint8_t, uint8_t, uint16_t>, public BusT4Listener {
+ public:
+  explicit ErrorTrigger(NiceBusT4 *parent) { parent->add_listener(this); }
+  void on_error(uint16_t address, uint8_t reg, uint8_t error) override { this->trigger(reg, error, address); }
+};
+
+// on_config: JSON report of a configuration snapshot, diff or restore and the base64 image of the drive
+class ConfigTrigger : public Trigger<std::string, std::string> {
+ public:
+  explicit ConfigTrigger(NiceBusT4 *parent) {
+    parent->add_on_config_callback(
+        [this](const std::string &report, const std::string &snapshot) { this->trigger(report, snapshot); });
+  }
+};
+
+// on_census: JSON list of the devices heard on the bus, requested by dump_census()
+class CensusTrigger : public Trigger<std::string> {
+ public:
+  explicit CensusTrigger(NiceBusT4 *parent) {
+    parent->add_on_census_callback([this](const std::string &census) { this->trigger(census); });
+  }
+};
+
+// on_benchmark: JSON report of a finished bus benchmark
+class BenchmarkTrigger : public Trigger<std::string> {
+ public:
+  explicit BenchmarkTrigger(NiceBusT4 *parent) {
+    parent->add_on_benchmark_callback([this](const std::string &report) { this->trigger(report); });
+  }
+};
+
+}  // namespace bus_t4
+}  // namespace esphome
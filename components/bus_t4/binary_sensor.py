@@ -0,0 +1,58 @@
+import esphome.codegen as cg
+import esphome.config_validation as cv
+from esphome.components import binary_sensor
+from esphome.const import CONF_TYPE
+
+from . import bus_t4_ns, BUS_T4_CHILD_SCHEMA, CONF_BUS_T4_ID
+
+DEPENDENCIES = ['bus_t4']
+
+CONF_REGISTER = 'register'
+CONF_BYTE = 'byte'
+CONF_BIT = 'bit'
+
+BusT4DiagBinarySensor = bus_t4_ns.class_('BusT4DiagBinarySensor', binary_sensor.BinarySensor, cg.Component)
+
+DIAG_REGISTERS = {
+    'inf_io': 0xD1,    # input-output status
+    'diag_bb': 0xD0,   # bluebus devices
+    'diag_par': 0xD2,  # other parameters
+}
+
+# known bits: register, payload byte, bit
+DIAG_TYPES = {
+    'limit_closed': ('inf_io', 2, 0),  # closing limit switch
+    'limit_opened': ('inf_io', 2, 1),  # opening limit switch
+}
+
+
+def validate_bit(config):
+    if CONF_TYPE in config:
+        if CONF_REGISTER in config:
+            raise cv.Invalid("Use either 'type' or 'register', 'byte' and 'bit'")
+        return config
+    if CONF_REGISTER not in config:
+        raise cv.Invalid("'type' or 'register' is required")
+    return config
+
+
+CONFIG_SCHEMA = cv.All(binary_sensor.binary_sensor_schema(BusT4DiagBinarySensor).extend({
+    cv.Optional(CONF_TYPE): cv.enum(DIAG_TYPES, lower=True),
+    cv.Optional(CONF_REGISTER): cv.enum(DIAG_REGISTERS, lower=True),
+    cv.Optional(CONF_BYTE, default=0): cv.int_range(min=0, max=15),
+    cv.Optional(CONF_BIT, default=0): cv.int_range(min=0, max=7),
+}).extend(BUS_T4_CHILD_SCHEMA).extend(cv.COMPONENT_SCHEMA), validate_bit)
+
+
+def to_code(config):
+    var = yield binary_sensor.new_binary_sensor(config)
+    yield cg.register_component(var, config)
+
+    parent = yield cg.get_variable(config[CONF_BUS_T4_ID])
+    cg.add(var.set_bus_t4_parent(parent))
+
+    if CONF_TYPE in config:
+        reg, byte, bit = DIAG_TYPES[config[CONF_TYPE]]
+    else:
+        reg, byte, bit = config[CONF_REGISTER], config[CONF_BYTE], config[CONF_BIT]
+    cg.add(var.set_bit(DIAG_REGISTERS[reg], byte, bit))
@@ -0,0 +1,26 @@
+#include "bus_t4_binary_sensor.h"
+#ifdef USE_BINARY_SENSOR
+#include "esphome/core/log.h"
+
+namespace esphome {
+namespace bus_t4 {
+
+static const char *TAG = "bus_t4.binary_sensor";
+
+void BusT4DiagBinarySensor::setup() {
+  this->parent_->add_on_diag_callback([this](uint8_t reg, const uint8_t *data, uint8_t len, const uint8_t *changed) {
+    if ((reg != this->reg_) || (this->byte_ >= len) || !(changed[this->byte_] & this->mask_))
+      return;
+    this->publish_state(data[this->byte_] & this->mask_);
+  });
+}
+
+void BusT4DiagBinarySensor::dump_config() {
+  LOG_BINARY_SENSOR("", "Bus T4 diagnostics", this);
+  ESP_LOGCONFIG(TAG, "  Register: 0x%02X, byte %u, mask 0x%02X", this->reg_, this->byte_, this->mask_);
+}
+
+}  // namespace bus_t4
+}  // namespace esphome
+
+#endif  // USE_BINARY_SENSOR
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "esphome/core/defines.h"
+#ifdef USE_BINARY_SENSOR
+
+#include "esphome/core/component.h"
+#include "esphome/components/binary_sensor/binary_sensor.h"
+#include "nice-bust4.h"
+
+namespace esphome {
+namespace bus_t4 {
+
+// one bit of a diagnostics register payload (INF_IO, DIAG_BB, DIAG_PAR), published only when it changes
+class BusT4DiagBinarySensor : public binary_sensor::BinarySensor, public Component {
+ public:
+  void setup() override;
+  void dump_config() override;
+
+  void set_bus_t4_parent(NiceBusT4 *parent) { this->parent_ = parent; }
+  void set_bit(uint8_t reg, uint8_t byte, uint8_t bit) {
+    this->reg_ = reg;
+    this->byte_ = byte;
+    this->mask_ = 1 << bit;
+  }
+
+ protected:
+  NiceBusT4 *parent_;
+  uint8_t reg_;
+  uint8_t byte_;  // payload byte, 0 - first byte after the error byte
+  uint8_t mask_;
+};
+
+}  // namespace bus_t4
+}  // namespace esphome
+
+#endif  // USE_BINARY_SENSOR
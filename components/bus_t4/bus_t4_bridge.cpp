@@ -0,0 +1,146 @@
+#include "bus_t4_bridge.h"
+#ifdef USE_BUS_T4_BRIDGE
+#include "esphome/core/log.h"
+#include <cerrno>
+#include <cstring>
+
+namespace esphome {
+namespace bus_t4 {
+
+static const char *TAG = "bus_t4.bridge";
+
+void BusT4Bridge::setup() {
+  this->server_ = socket::socket_ip(SOCK_STREAM, 0);
+  if (this->server_ == nullptr) {
+    ESP_LOGE(TAG, "Could not create the socket");
+    this->mark_failed();
+    return;
+  }
+  int enable = 1;
+  this->server_->setsockopt(SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+  this->server_->setblocking(false);
+  struct sockaddr_storage addr;
+  socklen_t addr_len = socket::set_sockaddr_any((struct sockaddr *) &addr, sizeof(addr), this->port_);
+  if ((this->server_->bind((struct sockaddr *) &addr, addr_len) != 0) || (this->server_->listen(1) != 0)) {
+    ESP_LOGE(TAG, "Could not listen on port %u: errno %d", this->port_, errno);
+    this->mark_failed();
+    return;
+  }
+  this->parent_->add_on_frame_callback([this](uint8_t dir, const uint8_t *data, size_t len, uint8_t status) {
+    if ((this->client_ != nullptr) && (status == FRAME_OK))
+      this->forward_(dir, data, len);
+  });
+}
+
+void BusT4Bridge::loop() {
+  this->accept_();
+  if (this->client_ == nullptr)
+    return;
+  this->flush_();
+  if (this->client_ == nullptr)  // the write failed and closed it
+    return;
+  this->receive_();
+}
+
+void BusT4Bridge::accept_() {
+  struct sockaddr_storage addr;
+  socklen_t addr_len = sizeof(addr);
+  auto client = this->server_->accept((struct sockaddr *) &addr, &addr_len);
+  if (client == nullptr)
+    return;
+  if (this->client_ != nullptr)
+    ESP_LOGI(TAG, "New client, closing the previous one");
+  this->close_();
+  int enable = 1;
+  client->setblocking(false);
+  client->setsockopt(IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+  this->client_ = std::move(client);
+  ESP_LOGI(TAG, "Client %s connected", this->client_->getpeername().c_str());
+}
+
+void BusT4Bridge::close_() {
+  if (this->client_ != nullptr)
+    this->client_->close();
+  if (this->dropped_ > 0)
+    ESP_LOGW(TAG, "%u frames to the client were dropped: it did not keep up or they were too long", this->dropped_);
+  this->dropped_ = 0;
+  this->client_ = nullptr;
+  this->in_len_ = 0;
+  this->out_len_ = 0;
+}
+
+void BusT4Bridge::forward_(uint8_t dir, const uint8_t *data, size_t len) {
+  if ((len > BRIDGE_FRAME_MAX) || !this->flush_()) {  // a partial frame still waits, the socket is full
+    this->dropped_++;
+    return;
+  }
+  uint8_t header[BRIDGE_HEADER] = {(uint8_t) len, dir};
+  struct iovec iov[2] = {{header, sizeof(header)}, {(void *) data, len}};
+  ssize_t sent = this->client_->writev(iov, 2);
+  if (sent < 0) {
+    if ((errno != EWOULDBLOCK) && (errno != EAGAIN)) {
+      ESP_LOGW(TAG, "Client write failed: errno %d", errno);
+      this->close_();
+      return;
+    }
+    this->dropped_++;
+    return;
+  }
+  size_t total = sizeof(header) + len;
+  if ((size_t) sent == total)
+    return;
+  // keep the rest so the frame boundaries survive
+  size_t skip = sent;
+  for (auto &part : iov) {
+    size_t take = std::min(skip, part.iov_len);
+    memcpy(this->out_ + this->out_len_, (uint8_t *) part.iov_base + take, part.iov_len - take);
+    this->out_len_ += part.iov_len - take;
+    skip -= take;
+  }
+}
+
+bool BusT4Bridge::flush_() {
+  if (this->out_len_ == 0)
+    return true;
+  ssize_t sent = this->client_->write(this->out_, this->out_len_);
+  if (sent < 0) {
+    if ((errno != EWOULDBLOCK) && (errno != EAGAIN))
+      this->close_();
+    return false;
+  }
+  this->out_len_ -= sent;
+  memmove(this->out_, this->out_ + sent, this->out_len_);
+  return this->out_len_ == 0;
+}
+
+void BusT4Bridge::receive_() {
+  ssize_t read = this->client_->read(this->in_ + this->in_len_, sizeof(this->in_) - this->in_len_);
+  if (read == 0 || ((read < 0) && (errno != EWOULDBLOCK) && (errno != EAGAIN))) {
+    ESP_LOGI(TAG, "Client disconnected");
+    this->close_();
+    return;
+  }
+  if (read < 0)
+    return;
+  this->in_len_ += read;
+  while (this->in_len_ >= BRIDGE_HEADER) {
+    size_t len = this->in_[0];
+    if (this->in_len_ < BRIDGE_HEADER + len)
+      return;  // the rest comes later
+    if (!this->parent_->send_frame(this->in_ + BRIDGE_HEADER, len, this->priority_))
+      ESP_LOGW(TAG, "Frame from the client rejected: %s", format_hex_pretty(this->in_ + BRIDGE_HEADER, len).c_str());
+    this->in_len_ -= BRIDGE_HEADER + len;
+    memmove(this->in_, this->in_ + BRIDGE_HEADER + len, this->in_len_);
+  }
+}
+
+void BusT4Bridge::dump_config() {
+  ESP_LOGCONFIG(TAG, "Bus T4 TCP bridge:");
+  ESP_LOGCONFIG(TAG, "  Port: %u", this->port_);
+  ESP_LOGCONFIG(TAG, "  Priority of client frames: %u", this->priority_);
+}
+
+}  // namespace bus_t4
+}  // namespace esphome
+
+#endif  // USE_BUS_T4_BRIDGE
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "esphome/core/defines.h"
+#ifdef USE_BUS_T4_BRIDGE
+
+#include "esphome/core/component.h"
+#include "esphome/components/socket/socket.h"
+#include "nice-bust4.h"
+#include <memory>
+
+namespace esphome {
+namespace bus_t4 {
+
+/* Raw frames over TCP, one client at a time. Every frame in both directions is preceded by its length and
+   a direction byte (FRAME_RX - received from the bus, FRAME_TX - sent by the gateway); the break before
+   each frame is implied. Frames from the client are checked (size, CRC1, CRC2) and queued for the bus. */
+static const uint8_t BRIDGE_HEADER = 2;
+static const uint16_t BRIDGE_FRAME_MAX = 255;  // the length is one byte, longer frames are not forwarded
+
+class BusT4Bridge : public Component {
+ public:
+  BusT4Bridge(NiceBusT4 *parent) : parent_(parent) {}
+  void setup() override;
+  void loop() override;
+  void dump_config() override;
+  float get_setup_priority() const override { return setup_priority::AFTER_WIFI; }
+
+  void set_port(uint16_t port) { this->port_ = port; }
+  void set_priority(uint8_t priority) { this->priority_ = priority; }
+
+ protected:
+  void forward_(uint8_t dir, const uint8_t *data, size_t len);  // bus to client, straight from the frame buffer
+  void accept_();
+  void receive_();  // client to bus
+  bool flush_();    // rest of a partially written frame, true when nothing is left
+  void close_();
+
+  NiceBusT4 *parent_;
+  uint16_t port_;
+  uint8_t priority_{TX_LOW};
+  std::unique_ptr<socket::Socket> server_;
+  std::unique_ptr<socket::Socket> client_;
+  uint8_t in_[BRIDGE_HEADER + RAW_FRAME_MAX];   // frame being received from the client
+  size_t in_len_{0};
+  uint8_t out_[BRIDGE_HEADER + RAW_FRAME_MAX];  // rest of a frame the socket did not take at once
+  size_t out_len_{0};
+  uint32_t dropped_{0};  // frames to the client lost to a full socket or too long for the header
+};
+
+}  // namespace bus_t4
+}  // namespace esphome
+
+#endif  // USE_BUS_T4_BRIDGE
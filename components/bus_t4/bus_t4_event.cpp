@@ -0,0 +1,35 @@
+#include "bus_t4_event.h"
+#ifdef USE_EVENT
+#include "esphome/core/log.h"
+
+namespace esphome {
+namespace bus_t4 {
+
+static const char *TAG = "bus_t4.event";
+
+// event types are looked up, never formatted
+static const char *const BUTTON_EVENT_TYPES[16] = {
+    "button_0", "button_1", "button_2",  "button_3",  "button_4",  "button_5",  "button_6",  "button_7",
+    "button_8", "button_9", "button_10", "button_11", "button_12", "button_13", "button_14", "button_15",
+};
+
+void BusT4RemoteEvent::setup() { this->parent_->add_listener(this); }
+
+void BusT4RemoteEvent::on_remote(const RemoteEvent &event) {
+  if (this->has_serial_ && event.serial != this->serial_)
+    return;
+  if (!(this->buttons_ & (1 << (event.button & 0x0F))))  // not among the event types
+    return;
+  this->trigger(BUTTON_EVENT_TYPES[event.button & 0x0F]);
+}
+
+void BusT4RemoteEvent::dump_config() {
+  LOG_EVENT("", "Bus T4 remote control", this);
+  if (this->has_serial_)
+    ESP_LOGCONFIG(TAG, "  Remote control: %07X", this->serial_);
+}
+
+}  // namespace bus_t4
+}  // namespace esphome
+
+#endif  // USE_EVENT
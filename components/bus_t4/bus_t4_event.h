@@ -0,0 +1,37 @@
+#pragma once
+
+#include "esphome/core/defines.h"
+#ifdef USE_EVENT
+
+#include "esphome/core/component.h"
+#include "esphome/components/event/event.h"
+#include "nice-bust4.h"
+
+namespace esphome {
+namespace bus_t4 {
+
+// remote control presses as a Home Assistant event entity, event type = pressed button
+class BusT4RemoteEvent : public event::Event, public Component, public BusT4Listener {
+ public:
+  void setup() override;
+  void dump_config() override;
+  void on_remote(const RemoteEvent &event) override;
+
+  void set_bus_t4_parent(NiceBusT4 *parent) { this->parent_ = parent; }
+  void set_serial(uint32_t serial) {
+    this->serial_ = serial;
+    this->has_serial_ = true;
+  }
+  void set_buttons(uint16_t mask) { this->buttons_ = mask; }
+
+ protected:
+  NiceBusT4 *parent_;
+  uint32_t serial_{0};
+  bool has_serial_{false};  // without a serial number all remote controls are reported
+  uint16_t buttons_{0};      // bit n - button_n is an event type of the entity
+};
+
+}  // namespace bus_t4
+}  // namespace esphome
+
+#endif  // USE_EVENT
@@ -0,0 +1,92 @@
+#include "bus_t4_monitor.h"
+#ifdef USE_BUS_T4_MONITOR
+#include "esphome/core/log.h"
+#include <algorithm>
+#include <cstring>
+
+namespace esphome {
+namespace bus_t4 {
+
+static const char *TAG = "bus_t4.monitor";
+
+static const char *const STATUS_NAMES[] = {"ok", "crc1", "crc2", "size"};
+
+void BusT4Monitor::setup() {
+  this->base_->init();
+  this->events_.onConnect([this](AsyncEventSourceClient *client) {
+    char buf[48];
+    snprintf(buf, sizeof(buf), "{\"dropped\":%u}", this->dropped_);
+    client->send(buf, "hello", this->id_, 1000);
+  });
+  this->base_->add_handler(&this->events_);
+  this->parent_->add_on_frame_callback([this](uint8_t dir, const uint8_t *data, size_t len, uint8_t status) {
+    this->add_frame_(dir, data, len, status);
+  });
+}
+
+void BusT4Monitor::add_frame_(uint8_t dir, const uint8_t *data, size_t len, uint8_t status) {
+  if (this->events_.count() == 0) {  // nobody watches
+    this->count_ = 0;
+    return;
+  }
+  if (this->count_ == MONITOR_FRAMES) {  // drop the oldest
+    this->head_ = (this->head_ + 1) % MONITOR_FRAMES;
+    this->count_--;
+    this->dropped_++;
+  }
+  MonitorFrame &frame = this->frames_[(this->head_ + this->count_) % MONITOR_FRAMES];
+  this->count_++;
+  frame.time = millis();
+  frame.dir = dir;
+  frame.status = status;
+  frame.len = std::min<size_t>(len, 255);
+  memcpy(frame.data, data, std::min<size_t>(len, MONITOR_FRAME_MAX));
+}
+
+void BusT4Monitor::loop() {
+  for (uint8_t i = 0; (i < MONITOR_SEND_PER_LOOP) && (this->count_ > 0); i++) {
+    if (this->events_.avgPacketsWaiting() > MONITOR_CLIENT_BACKLOG)
+      return;  // the viewers are behind, the ring takes the load
+    this->send_frame_(this->frames_[this->head_]);
+    this->head_ = (this->head_ + 1) % MONITOR_FRAMES;
+    this->count_--;
+  }
+}
+
+// {"t":ms,"dir":"rx","to":"00FF","from":"0066","type":8,"sub":"01","run":"99","err":0,"data":"...","crc":"ok",
+//  "raw":"55 0C ...","dropped":0}
+void BusT4Monitor::send_frame_(const MonitorFrame &frame) {
+  uint8_t kept = std::min<uint8_t>(frame.len, MONITOR_FRAME_MAX);
+  const uint8_t *d = frame.data;
+  char buf[96 + 3 * MONITOR_FRAME_MAX * 2];
+  int pos = snprintf(buf, sizeof(buf), "{\"t\":%u,\"dir\":\"%s\",\"crc\":\"%s\",\"len\":%u,\"dropped\":%u", frame.time,
+                     frame.dir == FRAME_TX ? "tx" : "rx", STATUS_NAMES[frame.status & 3], frame.len, this->dropped_);
+  if (kept >= 8)
+    pos += snprintf(buf + pos, sizeof(buf) - pos, ",\"to\":\"%02X%02X\",\"from\":\"%02X%02X\",\"type\":\"%s\"", d[2], d[3],
+                    d[4], d[5], d[6] == CMD ? "CMD" : (d[6] == INF ? "INF" : "?"));
+  if (kept >= 14) {
+    pos += snprintf(buf + pos, sizeof(buf) - pos, ",\"whose\":\"%02X\",\"sub\":\"%02X\",\"run\":\"%02X\",\"err\":%u", d[9],
+                    d[10], d[11], d[13]);
+    pos += snprintf(buf + pos, sizeof(buf) - pos, ",\"data\":\"");
+    uint8_t end = frame.len > kept ? kept : frame.len - 2;  // CRC2 and size are not payload
+    for (uint8_t i = 14; (i < end) && (pos + 4 < (int) sizeof(buf)); i++)
+      pos += snprintf(buf + pos, sizeof(buf) - pos, "%02X", d[i]);
+    pos += snprintf(buf + pos, sizeof(buf) - pos, "\"");
+  }
+  pos += snprintf(buf + pos, sizeof(buf) - pos, ",\"raw\":\"");
+  for (uint8_t i = 0; (i < kept) && (pos + 8 < (int) sizeof(buf)); i++)
+    pos += snprintf(buf + pos, sizeof(buf) - pos, i == 0 ? "%02X" : " %02X", d[i]);
+  snprintf(buf + pos, sizeof(buf) - pos, "\"}");
+  this->events_.send(buf, "frame", ++this->id_);
+}
+
+void BusT4Monitor::dump_config() {
+  ESP_LOGCONFIG(TAG, "Bus T4 monitor:");
+  ESP_LOGCONFIG(TAG, "  Path: %s", this->path_);
+  ESP_LOGCONFIG(TAG, "  Frames kept for slow viewers: %u", MONITOR_FRAMES);
+}
+
+}  // namespace bus_t4
+}  // namespace esphome
+
+#endif  // USE_BUS_T4_MONITOR
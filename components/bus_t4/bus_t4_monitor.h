@@ -0,0 +1,56 @@
+#pragma once
+
+#include "esphome/core/defines.h"
+#ifdef USE_BUS_T4_MONITOR
+
+#include "esphome/core/component.h"
+#include "esphome/components/web_server_base/web_server_base.h"
+#include "nice-bust4.h"
+
+namespace esphome {
+namespace bus_t4 {
+
+static const uint8_t MONITOR_FRAMES = 32;         // frames waiting for the viewers
+static const uint8_t MONITOR_FRAME_MAX = 64;      // bytes kept of each frame, longer ones are cut
+static const uint8_t MONITOR_SEND_PER_LOOP = 4;   // events sent in one loop()
+static const uint8_t MONITOR_CLIENT_BACKLOG = 8;  // events waiting in a viewer's queue before we hold back
+
+struct MonitorFrame {
+  uint32_t time;    // millis()
+  uint8_t dir;      // frame_direction
+  uint8_t status;   // frame_status
+  uint8_t len;      // bytes of the frame on the bus
+  uint8_t data[MONITOR_FRAME_MAX];
+};
+
+// decoded bus frames streamed as server-sent events; frames are only kept while a viewer is connected,
+// a full ring drops the oldest frames so a slow viewer never holds up the bus
+class BusT4Monitor : public Component {
+ public:
+  BusT4Monitor(NiceBusT4 *parent, const char *path) : parent_(parent), path_(path), events_(path) {}
+  void setup() override;
+  void loop() override;
+  void dump_config() override;
+  float get_setup_priority() const override { return setup_priority::WIFI - 1.0f; }
+
+  void set_base(web_server_base::WebServerBase *base) { this->base_ = base; }
+
+ protected:
+  void add_frame_(uint8_t dir, const uint8_t *data, size_t len, uint8_t status);
+  void send_frame_(const MonitorFrame &frame);
+
+  NiceBusT4 *parent_;
+  const char *path_;
+  web_server_base::WebServerBase *base_;
+  AsyncEventSource events_;
+  MonitorFrame frames_[MONITOR_FRAMES];
+  uint8_t head_{0};      // oldest frame
+  uint8_t count_{0};
+  uint32_t id_{0};       // event id of the last frame sent
+  uint32_t dropped_{0};  // frames lost to a full ring
+};
+
+}  // namespace bus_t4
+}  // namespace esphome
+
+#endif  // USE_BUS_T4_MONITOR
@@ -0,0 +1,41 @@
+#include "bus_t4_number.h"
+#ifdef USE_NUMBER
+#include "esphome/core/log.h"
+
+namespace esphome {
+namespace bus_t4 {
+
+static const char *TAG = "bus_t4.number";
+
+void BusT4Number::setup() {
+  this->parent_->watch_register(this->reg_);
+  this->parent_->add_listener(this);
+}
+
+void BusT4Number::on_register(uint16_t address, uint8_t reg, const uint8_t *data, uint8_t len) {
+  if ((reg != this->reg_) || (len < this->len_))
+    return;
+  uint32_t value = register_value(data, this->len_);
+  if (this->known_ && (value == this->value_))
+    return;
+  this->known_ = true;
+  this->value_ = value;
+  this->publish_state(value);
+}
+
+void BusT4Number::control(float value) {
+  this->parent_->set_register(this->reg_, (uint32_t) value, this->len_, [this](uint8_t result) {
+    if ((result != AWAIT_OK) && this->known_)
+      this->publish_state(this->value_);
+  });
+}
+
+void BusT4Number::dump_config() {
+  LOG_NUMBER("", "Bus T4 number", this);
+  ESP_LOGCONFIG(TAG, "  Register: 0x%02X, %u bytes", this->reg_, this->len_);
+}
+
+}  // namespace bus_t4
+}  // namespace esphome
+
+#endif  // USE_NUMBER
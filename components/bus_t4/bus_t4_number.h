@@ -0,0 +1,39 @@
+#pragma once
+
+#include "esphome/core/defines.h"
+#ifdef USE_NUMBER
+
+#include "esphome/core/component.h"
+#include "esphome/components/number/number.h"
+#include "nice-bust4.h"
+
+namespace esphome {
+namespace bus_t4 {
+
+// numeric register of the drive, written with a verifying read and published only when the drive reports a change
+class BusT4Number : public number::Number, public Component, public BusT4Listener {
+ public:
+  void setup() override;
+  void dump_config() override;
+  void on_register(uint16_t address, uint8_t reg, const uint8_t *data, uint8_t len) override;
+
+  void set_bus_t4_parent(NiceBusT4 *parent) { this->parent_ = parent; }
+  void set_register(uint8_t reg, uint8_t len) {
+    this->reg_ = reg;
+    this->len_ = len;
+  }
+
+ protected:
+  void control(float value) override;
+
+  NiceBusT4 *parent_;
+  uint8_t reg_;
+  uint8_t len_{1};       // value bytes, big-endian
+  bool known_{false};    // a value was published
+  uint32_t value_{0};    // the last published value
+};
+
+}  // namespace bus_t4
+}  // namespace esphome
+
+#endif  // USE_NUMBER
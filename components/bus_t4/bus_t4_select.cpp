@@ -0,0 +1,48 @@
+#include "bus_t4_select.h"
+#ifdef USE_SELECT
+#include "esphome/core/log.h"
+
+namespace esphome {
+namespace bus_t4 {
+
+static const char *TAG = "bus_t4.select";
+
+void BusT4Select::setup() {
+  this->parent_->watch_register(this->reg_);
+  this->parent_->add_listener(this);
+}
+
+void BusT4Select::on_register(uint16_t address, uint8_t reg, const uint8_t *data, uint8_t len) {
+  if (reg != this->reg_)
+    return;
+  for (size_t i = 0; i < this->values_.size(); i++) {
+    if (this->values_[i] != data[0])
+      continue;
+    if (this->index_ != (int16_t) i) {
+      this->index_ = i;
+      this->publish_state(this->at(i).value());
+    }
+    return;
+  }
+  ESP_LOGW(TAG, "Register %02X: value %u has no option", reg, data[0]);
+}
+
+void BusT4Select::control(const std::string &value) {
+  auto index = this->index_of(value);
+  if (!index.has_value())
+    return;
+  this->parent_->set_register(this->reg_, this->values_[*index], 1, [this](uint8_t result) {
+    if ((result != AWAIT_OK) && (this->index_ >= 0))
+      this->publish_state(this->at(this->index_).value());
+  });
+}
+
+void BusT4Select::dump_config() {
+  LOG_SELECT("", "Bus T4 select", this);
+  ESP_LOGCONFIG(TAG, "  Register: 0x%02X", this->reg_);
+}
+
+}  // namespace bus_t4
+}  // namespace esphome
+
+#endif  // USE_SELECT
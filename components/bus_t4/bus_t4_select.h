@@ -0,0 +1,37 @@
+#pragma once
+
+#include "esphome/core/defines.h"
+#ifdef USE_SELECT
+
+#include <vector>
+#include "esphome/core/component.h"
+#include "esphome/components/select/select.h"
+#include "nice-bust4.h"
+
+namespace esphome {
+namespace bus_t4 {
+
+// register of the drive with a value for each option, published only when the drive reports a change
+class BusT4Select : public select::Select, public Component, public BusT4Listener {
+ public:
+  void setup() override;
+  void dump_config() override;
+  void on_register(uint16_t address, uint8_t reg, const uint8_t *data, uint8_t len) override;
+
+  void set_bus_t4_parent(NiceBusT4 *parent) { this->parent_ = parent; }
+  void set_register(uint8_t reg) { this->reg_ = reg; }
+  void set_values(std::vector<uint8_t> values) { this->values_ = std::move(values); }  // one per option
+
+ protected:
+  void control(const std::string &value) override;
+
+  NiceBusT4 *parent_;
+  uint8_t reg_;
+  std::vector<uint8_t> values_;
+  int16_t index_{-1};  // option published last, -1 - none yet
+};
+
+}  // namespace bus_t4
+}  // namespace esphome
+
+#endif  // USE_SELECT
@@ -0,0 +1,183 @@
+#include "bus_t4_sensor.h"
+#ifdef USE_SENSOR
+#include "esphome/core/log.h"
+#include <algorithm>
+#include <cmath>
+
+namespace esphome {
+namespace bus_t4 {
+
+static const char *TAG = "bus_t4.sensor";
+
+void BusT4MetricSensor::update() {
+  const BusMetrics &metrics = this->parent_->get_metrics();
+  float value = NAN;
+  switch (this->type_) {
+    case METRIC_RX_RATE:
+      value = this->rate_(metrics.frames_rx);
+      break;
+    case METRIC_TX_RATE:
+      value = this->rate_(metrics.frames_tx);
+      break;
+    case METRIC_CRC1_ERRORS:
+      value = metrics.crc1_errors;
+      break;
+    case METRIC_CRC2_ERRORS:
+      value = metrics.crc2_errors;
+      break;
+    case METRIC_SIZE_ERRORS:
+      value = metrics.size_errors;
+      break;
+    case METRIC_LOST_REPLIES:
+      value = metrics.lost_replies;
+      break;
+    case METRIC_OTHER_REQUESTS:
+      value = metrics.other_requests;
+      break;
+    case METRIC_ECHOES:
+      value = metrics.echoes;
+      break;
+    case METRIC_MISSING_ECHOES:
+      value = metrics.missing_echoes;
+      break;
+    case METRIC_RECOVERIES:
+      value = metrics.recoveries;
+      break;
+    case METRIC_RECOVERY_TIME:
+      value = metrics.recovery_time;
+      break;
+    case METRIC_BUS_DEVICES:
+      value = metrics.bus_devices;
+      break;
+    case METRIC_TX_QUEUE:
+      value = metrics.tx_queue_depth;
+      break;
+    case METRIC_TX_QUEUE_HIGH_WATER:
+      value = metrics.tx_queue_high_water;
+      break;
+    case METRIC_RSP_LATENCY:
+    case METRIC_EVT_LATENCY: {
+      const DeviceLatency *device =
+          this->parent_->get_device_latency(this->address_ != 0 ? this->address_ : this->parent_->get_to_address());
+      if (device != nullptr)
+        value = this->reduce_(this->type_ == METRIC_RSP_LATENCY ? device->rsp : device->evt);
+      break;
+    }
+    case METRIC_LOOP_TIME:
+      value = this->reduce_(metrics.loop_time);
+      break;
+    case METRIC_SEND_TIME:
+      value = this->reduce_(metrics.send_time);
+      break;
+  }
+  this->publish_state(value);
+}
+
+float BusT4MetricSensor::rate_(uint32_t counter) {
+  uint32_t now = millis();
+  float value = NAN;
+  if (this->last_time_ != 0)
+    value = (counter - this->last_counter_) * 1000.0f / (now - this->last_time_);
+  this->last_time_ = now;
+  this->last_counter_ = counter;
+  return value;
+}
+
+float BusT4MetricSensor::reduce_(const Histogram &hist) {
+  uint32_t count = hist.count - this->last_count_;
+  float value = NAN;
+  if (this->statistic_ == STAT_MAX) {
+    value = hist.max;
+  } else if (count > 0) {
+    if (this->statistic_ == STAT_MEAN) {
+      value = (hist.sum - this->last_sum_) * 1.0f / count;
+    } else {
+      uint32_t target = (count * 95 + 99) / 100;
+      uint32_t seen = 0;
+      for (uint8_t i = 0; i < HIST_BUCKETS; i++) {
+        seen += hist.buckets[i] - this->last_buckets_[i];
+        if (seen >= target) {
+          value = (i < HIST_BUCKETS - 1) ? (hist.base << i) : hist.max;
+          break;
+        }
+      }
+    }
+  }
+  this->last_count_ = hist.count;
+  this->last_sum_ = hist.sum;
+  memcpy(this->last_buckets_, hist.buckets, sizeof(this->last_buckets_));
+  return value;
+}
+
+void BusT4MetricSensor::dump_config() {
+  LOG_SENSOR("", "Bus T4 metric", this);
+  ESP_LOGCONFIG(TAG, "  Metric: %u, statistic: %u", this->type_, this->statistic_);
+  if (this->address_ != 0)
+    ESP_LOGCONFIG(TAG, "  Device address: 0x%04X", this->address_);
+}
+
+void BusT4RegisterSensor::setup() {
+  this->parent_->watch_register(this->reg_);
+  this->parent_->add_listener(this);
+}
+
+void BusT4RegisterSensor::on_register(uint16_t address, uint8_t reg, const uint8_t *data, uint8_t len) {
+  if ((reg != this->reg_) || (len < this->len_))
+    return;
+  uint32_t value = register_value(data, this->len_);
+  if (this->known_ && (value == this->value_))
+    return;
+  this->known_ = true;
+  this->value_ = value;
+  this->publish_state(value);
+}
+
+void BusT4RegisterSensor::dump_config() {
+  LOG_SENSOR("", "Bus T4 register", this);
+  ESP_LOGCONFIG(TAG, "  Register: 0x%02X, %u bytes", this->reg_, this->len_);
+}
+
+void BusT4EtaSensor::update() {
+  float eta = roundf(this->parent_->get_eta());
+  if ((eta == this->state) || (std::isnan(eta) && std::isnan(this->state)))
+    return;
+  this->publish_state(eta);
+}
+
+void BusT4EtaSensor::dump_config() {
+  LOG_SENSOR("", "Bus T4 maneuver ETA", this);
+  const TravelModel &model = this->parent_->get_travel_model();
+  ESP_LOGCONFIG(TAG, "  Travel: open %u ms, close %u ms", model.dir[0].travel, model.dir[1].travel);
+}
+
+void BusT4MaintenanceSensor::update() {
+  float value = NAN;
+  switch (this->type_) {
+    case MAINT_CYCLES_PER_DAY:
+      value = this->parent_->get_cycles_per_day();
+      break;
+    case MAINT_DURATION_DRIFT:
+      value = this->parent_->get_duration_drift();
+      break;
+    case MAINT_CYCLES_UNTIL_SERVICE:
+      value = this->parent_->get_cycles_until_service();
+      break;
+    case MAINT_DAYS_UNTIL_SERVICE: {
+      float per_day = this->parent_->get_cycles_per_day();
+      if (per_day > 0)
+        value = std::max(this->parent_->get_cycles_until_service(), 0.0f) / per_day;
+      break;
+    }
+  }
+  this->publish_state(value);
+}
+
+void BusT4MaintenanceSensor::dump_config() {
+  LOG_SENSOR("", "Bus T4 maintenance", this);
+  ESP_LOGCONFIG(TAG, "  Type: %u", this->type_);
+}
+
+}  // namespace bus_t4
+}  // namespace esphome
+
+#endif  // USE_SENSOR
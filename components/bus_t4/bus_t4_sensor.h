@@ -0,0 +1,129 @@
+#pragma once
+
+#include "esphome/core/defines.h"
+#ifdef USE_SENSOR
+
+#include "esphome/core/component.h"
+#include "esphome/components/sensor/sensor.h"
+#include "nice-bust4.h"
+
+namespace esphome {
+namespace bus_t4 {
+
+enum MetricType : uint8_t {
+  METRIC_RX_RATE,              // frames/s received
+  METRIC_TX_RATE,              // frames/s sent
+  METRIC_CRC1_ERRORS,
+  METRIC_CRC2_ERRORS,
+  METRIC_SIZE_ERRORS,
+  METRIC_LOST_REPLIES,
+  METRIC_OTHER_REQUESTS,       // requests of other masters
+  METRIC_ECHOES,               // own frames read back
+  METRIC_MISSING_ECHOES,       // sent frames not seen on the line
+  METRIC_RECOVERIES,           // bus faults recovered by the watchdog
+  METRIC_RECOVERY_TIME,        // ms the last recovery took
+  METRIC_BUS_DEVICES,          // devices heard in the last minute
+  METRIC_TX_QUEUE,
+  METRIC_TX_QUEUE_HIGH_WATER,
+  METRIC_RSP_LATENCY,          // CMD -> RSP, ms
+  METRIC_EVT_LATENCY,          // GET -> EVT, ms
+  METRIC_LOOP_TIME,            // us
+  METRIC_SEND_TIME,            // us
+};
+
+enum MaintenanceType : uint8_t {
+  MAINT_CYCLES_PER_DAY,
+  MAINT_DURATION_DRIFT,        // %
+  MAINT_CYCLES_UNTIL_SERVICE,
+  MAINT_DAYS_UNTIL_SERVICE,    // cycles until service at the current cycles per day
+};
+
+/* how a histogram is reduced to one value */
+enum MetricStatistic : uint8_t {
+  STAT_MEAN,  // mean since the previous update
+  STAT_P95,   // 95th percentile since the previous update, upper bound of the bucket
+  STAT_MAX,   // maximum since boot
+};
+
+// bus metric published every update_interval, rates and histogram statistics cover the last interval
+class BusT4MetricSensor : public sensor::Sensor, public PollingComponent {
+ public:
+  BusT4MetricSensor() : PollingComponent(60000) {}
+  void update() override;
+  void dump_config() override;
+
+  void set_bus_t4_parent(NiceBusT4 *parent) { this->parent_ = parent; }
+  void set_type(MetricType type) { this->type_ = type; }
+  void set_statistic(MetricStatistic statistic) { this->statistic_ = statistic; }
+  void set_address(uint16_t address) { this->address_ = address; }
+
+ protected:
+  float rate_(uint32_t counter);
+  float reduce_(const Histogram &hist);
+
+  NiceBusT4 *parent_;
+  MetricType type_;
+  MetricStatistic statistic_{STAT_MEAN};
+  uint16_t address_{0};  // device for latencies, 0 - the drive unit
+
+  // values at the previous update
+  uint32_t last_time_{0};
+  uint32_t last_counter_{0};
+  uint32_t last_count_{0};
+  uint32_t last_sum_{0};
+  uint32_t last_buckets_[HIST_BUCKETS]{};
+};
+
+// numeric register of the drive, published only when the drive reports a change
+class BusT4RegisterSensor : public sensor::Sensor, public Component, public BusT4Listener {
+ public:
+  void setup() override;
+  void dump_config() override;
+  void on_register(uint16_t address, uint8_t reg, const uint8_t *data, uint8_t len) override;
+
+  void set_bus_t4_parent(NiceBusT4 *parent) { this->parent_ = parent; }
+  void set_register(uint8_t reg, uint8_t len) {
+    this->reg_ = reg;
+    this->len_ = len;
+  }
+
+ protected:
+  NiceBusT4 *parent_;
+  uint8_t reg_;
+  uint8_t len_{1};     // value bytes, big-endian
+  bool known_{false};  // a value was published
+  uint32_t value_{0};  // the last published value
+};
+
+// seconds until the current maneuver completes, from the learned travel times; published when it changes
+class BusT4EtaSensor : public sensor::Sensor, public PollingComponent {
+ public:
+  BusT4EtaSensor() : PollingComponent(1000) {}
+  void update() override;
+  void dump_config() override;
+
+  void set_bus_t4_parent(NiceBusT4 *parent) { this->parent_ = parent; }
+
+ protected:
+  NiceBusT4 *parent_;
+};
+
+// maintenance analytics from the daily and weekly cycle bins
+class BusT4MaintenanceSensor : public sensor::Sensor, public PollingComponent {
+ public:
+  BusT4MaintenanceSensor() : PollingComponent(60000) {}
+  void update() override;
+  void dump_config() override;
+
+  void set_bus_t4_parent(NiceBusT4 *parent) { this->parent_ = parent; }
+  void set_type(MaintenanceType type) { this->type_ = type; }
+
+ protected:
+  NiceBusT4 *parent_;
+  MaintenanceType type_;
+};
+
+}  // namespace bus_t4
+}  // namespace esphome
+
+#endif  // USE_SENSOR
@@ -0,0 +1,41 @@
+#include "bus_t4_switch.h"
+#ifdef USE_SWITCH
+#include "esphome/core/log.h"
+
+namespace esphome {
+namespace bus_t4 {
+
+static const char *TAG = "bus_t4.switch";
+
+void BusT4Switch::setup() {
+  this->parent_->watch_register(this->reg_);
+  this->parent_->add_listener(this);
+}
+
+void BusT4Switch::on_register(uint16_t address, uint8_t reg, const uint8_t *data, uint8_t len) {
+  if (reg != this->reg_)
+    return;
+  bool state = data[0] != 0;
+  if (this->known_ && (state == this->state))
+    return;
+  this->known_ = true;
+  this->publish_state(state);
+}
+
+void BusT4Switch::write_state(bool state) {
+  // the state is published by the verifying GET, a refused write shows the old state again
+  this->parent_->set_register(this->reg_, state ? 1 : 0, 1, [this](uint8_t result) {
+    if ((result != AWAIT_OK) && this->known_)
+      this->publish_state(this->state);
+  });
+}
+
+void BusT4Switch::dump_config() {
+  LOG_SWITCH("", "Bus T4 switch", this);
+  ESP_LOGCONFIG(TAG, "  Register: 0x%02X", this->reg_);
+}
+
+}  // namespace bus_t4
+}  // namespace esphome
+
+#endif  // USE_SWITCH
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "esphome/core/defines.h"
+#ifdef USE_SWITCH
+
+#include "esphome/core/component.h"
+#include "esphome/components/switch/switch.h"
+#include "nice-bust4.h"
+
+namespace esphome {
+namespace bus_t4 {
+
+// on/off register of the drive, written with a verifying read and published only when the drive reports a change
+class BusT4Switch : public switch_::Switch, public Component, public BusT4Listener {
+ public:
+  void setup() override;
+  void dump_config() override;
+  void on_register(uint16_t address, uint8_t reg, const uint8_t *data, uint8_t len) override;
+
+  void set_bus_t4_parent(NiceBusT4 *parent) { this->parent_ = parent; }
+  void set_register(uint8_t reg) { this->reg_ = reg; }
+
+ protected:
+  void write_state(bool state) override;
+
+  NiceBusT4 *parent_;
+  uint8_t reg_;
+  bool known_{false};  // a value was published
+};
+
+}  // namespace bus_t4
+}  // namespace esphome
+
+#endif  // USE_SWITCH
@@ -0,0 +1,34 @@
+#include "bus_t4_text_sensor.h"
+#ifdef USE_TEXT_SENSOR
+#include "esphome/core/log.h"
+
+namespace esphome {
+namespace bus_t4 {
+
+static const char *TAG = "bus_t4.text_sensor";
+
+void BusT4TextSensor::setup() {
+  this->parent_->watch_register(this->reg_);
+  this->parent_->add_listener(this);
+}
+
+void BusT4TextSensor::on_register(uint16_t address, uint8_t reg, const uint8_t *data, uint8_t len) {
+  if ((reg != this->reg_) || (len < this->len_))
+    return;
+  uint32_t value = register_value(data, this->len_);
+  auto it = this->texts_.find(value);
+  std::string text = (it != this->texts_.end()) ? it->second : std::to_string(value);
+  if (this->has_state() && (text == this->state))
+    return;
+  this->publish_state(text);
+}
+
+void BusT4TextSensor::dump_config() {
+  LOG_TEXT_SENSOR("", "Bus T4 register", this);
+  ESP_LOGCONFIG(TAG, "  Register: 0x%02X, %u bytes, %u named values", this->reg_, this->len_, (unsigned) this->texts_.size());
+}
+
+}  // namespace bus_t4
+}  // namespace esphome
+
+#endif  // USE_TEXT_SENSOR
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "esphome/core/defines.h"
+#ifdef USE_TEXT_SENSOR
+
+#include <map>
+#include "esphome/core/component.h"
+#include "esphome/components/text_sensor/text_sensor.h"
+#include "nice-bust4.h"
+
+namespace esphome {
+namespace bus_t4 {
+
+// register of the drive as text: a name from the map, or the number; published only when it changes
+class BusT4TextSensor : public text_sensor::TextSensor, public Component, public BusT4Listener {
+ public:
+  void setup() override;
+  void dump_config() override;
+  void on_register(uint16_t address, uint8_t reg, const uint8_t *data, uint8_t len) override;
+
+  void set_bus_t4_parent(NiceBusT4 *parent) { this->parent_ = parent; }
+  void set_register(uint8_t reg, uint8_t len) {
+    this->reg_ = reg;
+    this->len_ = len;
+  }
+  void add_value(uint32_t value, const std::string &text) { this->texts_[value] = text; }
+
+ protected:
+  NiceBusT4 *parent_;
+  uint8_t reg_;
+  uint8_t len_{1};  // value bytes, big-endian
+  std::map<uint32_t, std::string> texts_;
+};
+
+}  // namespace bus_t4
+}  // namespace esphome
+
+#endif  // USE_TEXT_SENSOR
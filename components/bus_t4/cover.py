@@ -1,36 +1,251 @@
-import esphome.codegen as cg
-import esphome.config_validation as cv
-from esphome.components import cover
-from esphome.const import CONF_ADDRESS, CONF_ID, CONF_UPDATE_INTERVAL, CONF_USE_ADDRESS
-
-
-
-bus_t4_ns = cg.esphome_ns.namespace('bus_t4')
-Nice = bus_t4_ns.class_('NiceBusT4', cover.Cover, cg.Component)
-
-CONFIG_SCHEMA = cover.COVER_SCHEMA.extend({
-    cv.GenerateID(): cv.declare_id(Nice),
-    cv.Optional(CONF_ADDRESS): cv.hex_uint16_t,
-    cv.Optional(CONF_USE_ADDRESS): cv.hex_uint16_t,
-#    cv.Optional(CONF_UPDATE_INTERVAL): cv.positive_time_period_milliseconds,
-}).extend(cv.COMPONENT_SCHEMA)
-
-
-def to_code(config):
-    var = cg.new_Pvariable(config[CONF_ID])
-    yield cg.register_component(var, config)
-
-    yield cover.register_cover(var, config)
-
-    if CONF_ADDRESS in config:
-        address = config[CONF_ADDRESS]
-        cg.add(var.set_to_address(address))
-
-    if CONF_USE_ADDRESS in config:
-        use_address = config[CONF_USE_ADDRESS]
-        cg.add(var.set_from_address(use_address))
-        
-        
- #   if CONF_UPDATE_INTERVAL in config:
- #       update_interval = config[CONF_UPDATE_INTERVAL]
- #       cg.add(var.set_update_interval(update_interval))
+import esphome.codegen as cg
+import esphome.config_validation as cv
+from esphome import automation
+from esphome.components import cover, time, web_server_base
+from esphome.const import (
+    CONF_ADDRESS,
+    CONF_ID,
+    CONF_NAME,
+    CONF_PATH,
+    CONF_PORT,
+    CONF_PRIORITY,
+    CONF_TIME_ID,
+    CONF_TIMEOUT,
+    CONF_TRIGGER_ID,
+    CONF_UPDATE_INTERVAL,
+    CONF_USE_ADDRESS,
+    CONF_VALUE,
+)
+
+from . import bus_t4_ns, Nice, CONF_REGISTER, CONF_LENGTH, COMMANDS, STATUSES, TX_PRIORITIES, code_of
+
+AUTO_LOAD = ['socket']
+
+CONF_ON_REMOTE = 'on_remote'
+CONF_SERIAL = 'serial'
+CONF_BUTTON = 'button'
+CONF_DIAGNOSTICS_BUDGET = 'diagnostics_budget'
+CONF_TX_GAP = 'tx_gap'
+CONF_ON_BENCHMARK = 'on_benchmark'
+CONF_ON_REGISTER_CHANGE = 'on_register_change'
+CONF_POSITION_DEADBAND = 'position_deadband'
+CONF_POSITION_INTERVAL = 'position_interval'
+CONF_ON_STATUS = 'on_status'
+CONF_ON_TRACE = 'on_trace'
+CONF_ON_CONFIG = 'on_config'
+CONF_ON_CENSUS = 'on_census'
+CONF_ON_ERROR = 'on_error'
+CONF_SERVICE_INTERVAL = 'service_interval'
+CONF_MONITOR = 'monitor'
+CONF_BRIDGE = 'bridge'
+CONF_SEQUENCES = 'sequences'
+CONF_STEPS = 'steps'
+CONF_COMMAND = 'command'
+CONF_WAIT_STATUS = 'wait_status'
+CONF_WAIT_POSITION = 'wait_position'
+CONF_DELAY = 'delay'
+CONF_SET_REGISTER = 'set_register'
+CONF_ON_SEQUENCE_END = 'on_sequence_end'
+CONF_DRIVE = 'drive'
+CONF_IDLE_WATCH_INTERVAL = 'idle_watch_interval'
+CONF_IDLE_WATCH_BUDGET = 'idle_watch_budget'
+
+RemoteButtonTrigger = bus_t4_ns.class_('RemoteButtonTrigger', automation.Trigger.template(cg.uint32, cg.uint8))
+BenchmarkTrigger = bus_t4_ns.class_('BenchmarkTrigger', automation.Trigger.template(cg.std_string))
+RegisterChangeTrigger = bus_t4_ns.class_('RegisterChangeTrigger', automation.Trigger.template(cg.uint32, cg.uint16))
+TraceTrigger = bus_t4_ns.class_('TraceTrigger', automation.Trigger.template(cg.std_string))
+CensusTrigger = bus_t4_ns.class_('CensusTrigger', automation.Trigger.template(cg.std_string))
+ConfigTrigger = bus_t4_ns.class_('ConfigTrigger', automation.Trigger.template(cg.std_string, cg.std_string))
+StatusTrigger = bus_t4_ns.class_('StatusTrigger', automation.Trigger.template(cg.uint8, cg.uint16))
+BusT4Monitor = bus_t4_ns.class_('BusT4Monitor', cg.Component)
+BusT4Bridge = bus_t4_ns.class_('BusT4Bridge', cg.Component)
+SequenceEndTrigger = bus_t4_ns.class_('SequenceEndTrigger', automation.Trigger.template(cg.std_string, cg.bool_))
+SequenceStep = bus_t4_ns.enum('sequence_step')
+ErrorTrigger = bus_t4_ns.class_('ErrorTrigger', automation.Trigger.template(cg.uint8, cg.uint8, cg.uint16))
+
+# drive_family, 'auto' - found from the product the drive reports; DPRO924 needs nothing beyond the generic profile
+DRIVES = {
+    'generic': 0, 'walky': 1, 'robus': 2, 'road400': 3, 'dpro924': 0,
+}
+
+SEQUENCE_STEP_SCHEMA = cv.All(cv.Schema({
+    cv.Optional(CONF_COMMAND): code_of(COMMANDS),
+    cv.Optional(CONF_WAIT_STATUS): code_of(STATUSES),
+    cv.Optional(CONF_WAIT_POSITION): cv.percentage,
+    cv.Optional(CONF_DELAY): cv.positive_time_period_milliseconds,
+    cv.Optional(CONF_SET_REGISTER): cv.Schema({
+        cv.Required(CONF_REGISTER): cv.hex_uint8_t,
+        cv.Required(CONF_VALUE): cv.uint32_t,
+        cv.Optional(CONF_LENGTH, default=1): cv.int_range(min=1, max=4),
+    }),
+    cv.Optional(CONF_TIMEOUT): cv.positive_time_period_milliseconds,  # of a wait step
+}), cv.has_exactly_one_key(CONF_COMMAND, CONF_WAIT_STATUS, CONF_WAIT_POSITION, CONF_DELAY, CONF_SET_REGISTER))
+
+CONFIG_SCHEMA = cover.COVER_SCHEMA.extend({
+    cv.GenerateID(): cv.declare_id(Nice),
+    cv.Optional(CONF_ADDRESS): cv.hex_uint16_t,
+    cv.Optional(CONF_USE_ADDRESS): cv.hex_uint16_t,
+#    cv.Optional(CONF_UPDATE_INTERVAL): cv.positive_time_period_milliseconds,
+    cv.Optional(CONF_DRIVE, default='auto'): cv.one_of('auto', *DRIVES, lower=True),  # other profiles left out
+    cv.Optional(CONF_DIAGNOSTICS_BUDGET, default='5%'): cv.percentage,  # share of bus time for diagnostics polling
+    cv.Optional(CONF_TX_GAP, default='3ms'): cv.positive_time_period_microseconds,  # bus silence before sending
+    cv.Optional(CONF_POSITION_DEADBAND, default='1%'): cv.percentage,  # position change published in motion
+    cv.Optional(CONF_POSITION_INTERVAL, default='500ms'): cv.positive_time_period_milliseconds,  # between them
+    cv.Optional(CONF_IDLE_WATCH_INTERVAL, default='1s'): cv.positive_time_period_milliseconds,  # 0s - no probes
+    cv.Optional(CONF_IDLE_WATCH_BUDGET, default='3%'): cv.percentage,  # of bus time, stretches the interval
+    cv.Optional(CONF_SERVICE_INTERVAL, default=0): cv.uint32_t,  # cycles between services, for cycles_until_service
+    cv.Optional(CONF_TIME_ID): cv.use_id(time.RealTimeClock),  # days of the maintenance bins, uptime without it
+    cv.Optional(CONF_MONITOR): cv.Schema({  # decoded frames as server-sent events on the web server
+        cv.GenerateID(): cv.declare_id(BusT4Monitor),
+        cv.GenerateID(web_server_base.CONF_WEB_SERVER_BASE_ID): cv.use_id(web_server_base.WebServerBase),
+        cv.Optional(CONF_PATH, default='/bus_t4/events'): cv.string_strict,
+    }),
+    cv.Optional(CONF_BRIDGE): cv.Schema({  # raw frames over TCP for tools on a workstation
+        cv.GenerateID(): cv.declare_id(BusT4Bridge),
+        cv.Optional(CONF_PORT, default=6638): cv.port,
+        cv.Optional(CONF_PRIORITY, default='low'): cv.enum(TX_PRIORITIES, lower=True),  # of the client's frames
+    }),
+    cv.Optional(CONF_SEQUENCES): cv.All(cv.ensure_list(cv.Schema({  # run with bus_t4.run_sequence
+        cv.Required(CONF_NAME): cv.string_strict,
+        cv.Required(CONF_STEPS): cv.All(cv.ensure_list(SEQUENCE_STEP_SCHEMA), cv.Length(min=1, max=16)),
+    })), cv.Length(max=8)),
+    cv.Optional(CONF_ON_SEQUENCE_END): automation.validate_automation({  # 'name' and 'success'
+        cv.GenerateID(CONF_TRIGGER_ID): cv.declare_id(SequenceEndTrigger),
+    }),
+    cv.Optional(CONF_ON_REMOTE): automation.validate_automation({
+        cv.GenerateID(CONF_TRIGGER_ID): cv.declare_id(RemoteButtonTrigger),
+        cv.Optional(CONF_SERIAL): cv.hex_uint32_t,        # only this remote control
+        cv.Optional(CONF_BUTTON): cv.int_range(min=1, max=15),  # only this button
+    }),
+    cv.Optional(CONF_ON_BENCHMARK): automation.validate_automation({  # benchmark report as JSON in 'report'
+        cv.GenerateID(CONF_TRIGGER_ID): cv.declare_id(BenchmarkTrigger),
+    }),
+    cv.Optional(CONF_ON_REGISTER_CHANGE): automation.validate_automation({  # 'value' and source 'address'
+        cv.GenerateID(CONF_TRIGGER_ID): cv.declare_id(RegisterChangeTrigger),
+        cv.Required(CONF_REGISTER): cv.hex_uint8_t,
+        cv.Optional(CONF_LENGTH, default=1): cv.int_range(min=1, max=4),  # value bytes
+    }),
+    cv.Optional(CONF_ON_TRACE): automation.validate_automation({  # motion trace dump in 'trace', base64
+        cv.GenerateID(CONF_TRIGGER_ID): cv.declare_id(TraceTrigger),
+    }),
+    cv.Optional(CONF_ON_CONFIG): automation.validate_automation({  # 'report' as JSON and 'snapshot', base64
+        cv.GenerateID(CONF_TRIGGER_ID): cv.declare_id(ConfigTrigger),
+    }),
+    cv.Optional(CONF_ON_CENSUS): automation.validate_automation({  # device list as JSON in 'census'
+        cv.GenerateID(CONF_TRIGGER_ID): cv.declare_id(CensusTrigger),
+    }),
+    cv.Optional(CONF_ON_STATUS): automation.validate_automation({  # 'status' and source 'address'
+        cv.GenerateID(CONF_TRIGGER_ID): cv.declare_id(StatusTrigger),
+    }),
+    cv.Optional(CONF_ON_ERROR): automation.validate_automation({  # 'reg', 'error' and source 'address'
+        cv.GenerateID(CONF_TRIGGER_ID): cv.declare_id(ErrorTrigger),
+    }),
+}).extend(cv.COMPONENT_SCHEMA)
+
+
+def to_code(config):
+    var = cg.new_Pvariable(config[CONF_ID])
+    yield cg.register_component(var, config)
+
+    yield cover.register_cover(var, config)
+
+    if CONF_ADDRESS in config:
+        address = config[CONF_ADDRESS]
+        cg.add(var.set_to_address(address))
+
+    if CONF_USE_ADDRESS in config:
+        use_address = config[CONF_USE_ADDRESS]
+        cg.add(var.set_from_address(use_address))
+
+
+ #   if CONF_UPDATE_INTERVAL in config:
+ #       update_interval = config[CONF_UPDATE_INTERVAL]
+ #       cg.add(var.set_update_interval(update_interval))
+
+    if config[CONF_DRIVE] != 'auto':
+        cg.add_define('USE_BUS_T4_DRIVE', DRIVES[config[CONF_DRIVE]])
+        cg.add(var.set_drive(DRIVES[config[CONF_DRIVE]]))
+    cg.add(var.set_diag_budget(config[CONF_DIAGNOSTICS_BUDGET]))
+    cg.add(var.set_tx_gap(config[CONF_TX_GAP]))
+    cg.add(var.set_position_deadband(config[CONF_POSITION_DEADBAND]))
+    cg.add(var.set_position_interval(config[CONF_POSITION_INTERVAL]))
+    cg.add(var.set_idle_watch_interval(config[CONF_IDLE_WATCH_INTERVAL]))
+    cg.add(var.set_idle_watch_budget(config[CONF_IDLE_WATCH_BUDGET]))
+    cg.add(var.set_service_interval(config[CONF_SERVICE_INTERVAL]))
+    if CONF_TIME_ID in config:
+        clock = yield cg.get_variable(config[CONF_TIME_ID])
+        cg.add(var.set_time(clock))
+
+    if CONF_MONITOR in config:
+        conf = config[CONF_MONITOR]
+        cg.add_define('USE_BUS_T4_MONITOR')
+        monitor = cg.new_Pvariable(conf[CONF_ID], var, conf[CONF_PATH])
+        yield cg.register_component(monitor, conf)
+        base = yield cg.get_variable(conf[web_server_base.CONF_WEB_SERVER_BASE_ID])
+        cg.add(monitor.set_base(base))
+
+    if CONF_BRIDGE in config:
+        conf = config[CONF_BRIDGE]
+        cg.add_define('USE_BUS_T4_BRIDGE')
+        bridge = cg.new_Pvariable(conf[CONF_ID], var)
+        yield cg.register_component(bridge, conf)
+        cg.add(bridge.set_port(conf[CONF_PORT]))
+        cg.add(bridge.set_priority(conf[CONF_PRIORITY]))
+
+    for seq in config.get(CONF_SEQUENCES, []):
+        cg.add(var.add_sequence(seq[CONF_NAME]))
+        for step in seq[CONF_STEPS]:
+            timeout = step[CONF_TIMEOUT].total_milliseconds if CONF_TIMEOUT in step else 0
+            if CONF_COMMAND in step:
+                cg.add(var.add_sequence_step(SequenceStep.STEP_COMMAND, step[CONF_COMMAND], 0, 0, 0))
+            elif CONF_WAIT_STATUS in step:
+                cg.add(var.add_sequence_step(SequenceStep.STEP_WAIT_STATUS, step[CONF_WAIT_STATUS], 0, 0, timeout))
+            elif CONF_WAIT_POSITION in step:
+                position = int(round(step[CONF_WAIT_POSITION] * 1000))
+                cg.add(var.add_sequence_step(SequenceStep.STEP_WAIT_POSITION, 0, 0, position, timeout))
+            elif CONF_DELAY in step:
+                cg.add(var.add_sequence_step(SequenceStep.STEP_DELAY, 0, 0, step[CONF_DELAY].total_milliseconds, 0))
+            else:
+                reg = step[CONF_SET_REGISTER]
+                cg.add(var.add_sequence_step(SequenceStep.STEP_SET_REGISTER, reg[CONF_REGISTER], reg[CONF_LENGTH],
+                                             reg[CONF_VALUE], timeout))
+
+    for conf in config.get(CONF_ON_SEQUENCE_END, []):
+        trigger = cg.new_Pvariable(conf[CONF_TRIGGER_ID], var)
+        yield automation.build_automation(trigger, [(cg.std_string, 'name'), (cg.bool_, 'success')], conf)
+
+    for conf in config.get(CONF_ON_REMOTE, []):
+        trigger = cg.new_Pvariable(conf[CONF_TRIGGER_ID], var)
+        if CONF_SERIAL in conf:
+            cg.add(trigger.set_serial(conf[CONF_SERIAL]))
+        if CONF_BUTTON in conf:
+            cg.add(trigger.set_button(conf[CONF_BUTTON]))
+        yield automation.build_automation(trigger, [(cg.uint32, 'serial'), (cg.uint8, 'button')], conf)
+
+    for conf in config.get(CONF_ON_BENCHMARK, []):
+        trigger = cg.new_Pvariable(conf[CONF_TRIGGER_ID], var)
+        yield automation.build_automation(trigger, [(cg.std_string, 'report')], conf)
+
+    for conf in config.get(CONF_ON_REGISTER_CHANGE, []):
+        trigger = cg.new_Pvariable(conf[CONF_TRIGGER_ID], var, conf[CONF_REGISTER], conf[CONF_LENGTH])
+        yield automation.build_automation(trigger, [(cg.uint32, 'value'), (cg.uint16, 'address')], conf)
+
+    for conf in config.get(CONF_ON_TRACE, []):
+        trigger = cg.new_Pvariable(conf[CONF_TRIGGER_ID], var)
+        yield automation.build_automation(trigger, [(cg.std_string, 'trace')], conf)
+
+    for conf in config.get(CONF_ON_CONFIG, []):
+        trigger = cg.new_Pvariable(conf[CONF_TRIGGER_ID], var)
+        yield automation.build_automation(trigger, [(cg.std_string, 'report'), (cg.std_string, 'snapshot')], conf)
+
+    for conf in config.get(CONF_ON_CENSUS, []):
+        trigger = cg.new_Pvariable(conf[CONF_TRIGGER_ID], var)
+        yield automation.build_automation(trigger, [(cg.std_string, 'census')], conf)
+
+    for conf in config.get(CONF_ON_STATUS, []):
+        trigger = cg.new_Pvariable(conf[CONF_TRIGGER_ID], var)
+        yield automation.build_automation(trigger, [(cg.uint8, 'status'), (cg.uint16, 'address')], conf)
+
+    for conf in config.get(CONF_ON_ERROR, []):
+        trigger = cg.new_Pvariable(conf[CONF_TRIGGER_ID], var)
+        yield automation.build_automation(trigger, [(cg.uint8, 'reg'), (cg.uint8, 'error'), (cg.uint16, 'address')], conf)
@@ -0,0 +1,30 @@
+import esphome.codegen as cg
+import esphome.config_validation as cv
+from esphome.components import event
+
+from . import bus_t4_ns, BUS_T4_CHILD_SCHEMA, CONF_BUS_T4_ID
+
+DEPENDENCIES = ['bus_t4']
+
+CONF_SERIAL = 'serial'
+CONF_BUTTONS = 'buttons'
+
+BusT4RemoteEvent = bus_t4_ns.class_('BusT4RemoteEvent', event.Event, cg.Component)
+
+CONFIG_SCHEMA = event.event_schema(BusT4RemoteEvent).extend({
+    cv.Optional(CONF_SERIAL): cv.hex_uint32_t,  # only this remote control
+    cv.Optional(CONF_BUTTONS, default=[1, 2, 3, 4]): cv.ensure_list(cv.int_range(min=1, max=15)),
+}).extend(BUS_T4_CHILD_SCHEMA).extend(cv.COMPONENT_SCHEMA)
+
+
+def to_code(config):
+    event_types = ['button_%d' % button for button in config[CONF_BUTTONS]]
+    var = yield event.new_event(config, event_types=event_types)
+    yield cg.register_component(var, config)
+
+    parent = yield cg.get_variable(config[CONF_BUS_T4_ID])
+    cg.add(var.set_bus_t4_parent(parent))
+    cg.add(var.set_buttons(sum(1 << button for button in set(config[CONF_BUTTONS]))))
+
+    if CONF_SERIAL in config:
+        cg.add(var.set_serial(config[CONF_SERIAL]))
@@ -2,6 +2,9 @@
 #include "esphome/core/log.h"
 #include "esphome/core/helpers.h"  // to use auxiliary functions for working with strings
 #include "driver/uart.h"           // functions for ESP32 board type 
+#include "esp_heap_caps.h"          // free heap in dump_config
+#include <algorithm>
+#include <cmath>
 
 namespace esphome {
 namespace bus_t4 {
@@ -37,6 +40,7 @@ CoverTraits NiceBusT4::get_traits() {
 
 void NiceBusT4::control(const CoverCall &call) {
   position_hook_type = IGNORE;
+  position_target_ = NAN;
   if (call.get_stop()) {
     send_cmd(STOP);
 
@@ -49,7 +53,17 @@ void NiceBusT4::control(const CoverCall &call) {
       } else if (newpos == COVER_CLOSED) {
         if (current_operation != COVER_OPERATION_CLOSING) send_cmd(CLOSE);
 
+      } else if (!has_encoder_()) { // Arbitrary position from the travel model
+        CoverOperation op = newpos > position ? COVER_OPERATION_OPENING : COVER_OPERATION_CLOSING;
+        if (travel_.dir[op == COVER_OPERATION_CLOSING].travel == 0) {
+          ESP_LOGW(TAG, "Travel time not learned yet, open and close the gate fully once");
+          return;
+        }
+        position_target_ = newpos;
+        position_hook_type = op == COVER_OPERATION_OPENING ? STOP_UP : STOP_DOWN;
+        if (current_operation != op) send_cmd(op == COVER_OPERATION_OPENING ? OPEN : CLOSE);
       } else { // Arbitrary position
+        position_target_ = newpos;
         position_hook_value = (_pos_opn - _pos_cls) * newpos + _pos_cls;
         ESP_LOGI(TAG, "Required drive position: %d", position_hook_value);
         if (position_hook_value > _pos_usl) {
@@ -64,11 +78,50 @@ void NiceBusT4::control(const CoverCall &call) {
   }
 }
 
+static const DriveProfile DRIVE_PROFILES[] = {
+  // family, name, product_hash, position_format, poll_position, sta_opening, sta_closing
+  {DRIVE_GENERIC, "generic", 0, POSITION_U16, true, 0, 0},
+#if !defined(USE_BUS_T4_DRIVE) || (USE_BUS_T4_DRIVE == 1)
+  {DRIVE_WALKY, "walky", PRODUCT_WALKY, POSITION_U8, true, 0, 0},
+#endif
+#if !defined(USE_BUS_T4_DRIVE) || (USE_BUS_T4_DRIVE == 2)
+  {DRIVE_ROBUS, "robus", PRODUCT_ROBUSHSR10, POSITION_U16, false, 0, 0},
+#endif
+#if !defined(USE_BUS_T4_DRIVE) || (USE_BUS_T4_DRIVE == 3)
+  {DRIVE_ROAD, "road400", 0, POSITION_U16, true, 0x83, 0x84},  // its PRD reply is not known, chosen in YAML
+#endif
+};
+
+void NiceBusT4::set_drive(uint8_t family) {
+  for (const auto &profile : DRIVE_PROFILES) {
+    if (profile.family == family) {
+      this->drive_ = &profile;
+      this->drive_fixed_ = true;
+    }
+  }
+}
+
 void NiceBusT4::setup() {
+  if (this->drive_ == nullptr)
+    this->drive_ = &DRIVE_PROFILES[0];
+  this->metrics_.loop_time.base = 250;  // us
+  this->metrics_.send_time.base = 1000; // us
+  for (auto &device : this->metrics_.devices) {
+    device.rsp.base = 8;  // ms
+    device.evt.base = 8;  // ms
+  }
+  this->travel_pref_ = global_preferences->make_preference<TravelModel>(this->get_object_id_hash() ^ fnv1_hash("bus_t4_travel"));
+  if (this->travel_pref_.load(&this->travel_))
+    ESP_LOGI(TAG, "Travel times: open %u ms, close %u ms", this->travel_.dir[0].travel, this->travel_.dir[1].travel);
+  this->maint_pref_ = global_preferences->make_preference<MaintenanceLog>(this->get_object_id_hash() ^ fnv1_hash("bus_t4_maintenance"));
+  if (!this->maint_pref_.load(&this->maint_) || (this->maint_.today == 0))
+    this->maint_ = MaintenanceLog{};
+  if (this->maint_.today == 0)
+    this->maint_.today = 1;  // uptime days start at 1, 0 marks an empty bin
 
 
  // _uart =  uart_init(_UART_NO, BAUD_WORK, SERIAL_8N1, SERIAL_6E2, TX_P, 256, false); //for ESP8266
-  _uart =  uartBegin(_UART_NO, BAUD_WORK, SERIAL_8N1, RX_PIN, TX_PIN, 256, 256, false, 112); //for WT32
+  this->open_uart_();  //for WT32
   // who's online?
 //  this->tx_buffer_.push(gen_inf_cmd(0x00, 0xff, FOR_ALL, WHO, GET, 0x00));
 
@@ -84,13 +137,14 @@ void NiceBusT4::setup() {
 }
 
 void NiceBusT4::loop() {
+  uint32_t loop_start = micros();
 
   if ((millis() - this->last_update_) > 10000) {    // every 10 seconds // If the drive is not detected the first time, we will try later
-      std::vector<uint8_t> unknown = {0x55, 0x55};
       if (this->init_ok == false) {
         ESP_LOGI(TAG, "  Initialize device");
         ESP_LOGI(TAG, "  Who is online request");
         this->tx_buffer_.push(gen_inf_cmd(0x00, 0xff, FOR_ALL, WHO, GET, 0x00));
+        this->discovery_time_ = millis();
         ESP_LOGI(TAG, "  Product request");
         this->tx_buffer_.push(gen_inf_cmd(0x00, 0xff, FOR_ALL, PRD, GET, 0x00)); //product request
       } else if (this->class_gate_ == 0x55) {
@@ -98,7 +152,7 @@ void NiceBusT4::loop() {
         init_device(this->addr_to[0], this->addr_to[1], 0x04);  
         // this->tx_buffer_.push(gen_inf_cmd(0x00, 0xff, FOR_ALL, WHO, GET, 0x00));
         // this->tx_buffer_.push(gen_inf_cmd(0x00, 0xff, FOR_ALL, PRD, GET, 0x00)); //product request
-      } else if (this->manufacturer_ == unknown)  {
+      } else if (!this->identity_.known(ID_MANUFACTURER))  {
         ESP_LOGI(TAG, "  Initialize device - manufacturer");
         init_device(this->addr_to[0], this->addr_to[1], 0x04);  
         // this->tx_buffer_.push(gen_inf_cmd(0x00, 0xff, FOR_ALL, WHO, GET, 0x00));
@@ -108,42 +162,169 @@ void NiceBusT4::loop() {
   }  // if  every minute
 
 
-  // allow sending every 100 ms
-  uint32_t now = millis();
-  if (now - this->last_uart_byte_ > 100) {
-    this->ready_to_tx_ = true;
-    this->last_uart_byte_ = now;
-  } 
-
-
-  while (uartAvailable(_uart) > 0) {
-    //uint8_t c = (uint8_t)uart_Read(_uart);                // read the byte for ESP8266
-    uint8_t c = (uint8_t)uartRead(_uart);                // read the byte for ESP32
-    this->handle_char_(c);                                     // send the byte for processing
-    this->last_uart_byte_ = now;
-  } //while
-
-  if (this->ready_to_tx_) {   // if possible send
-    if (!this->tx_buffer_.empty()) {  // if you have anything to send
-      this->send_array_cmd(this->tx_buffer_.front()); // send the first command in the queue
-      this->tx_buffer_.pop();
-      this->ready_to_tx_ = false;
+  if (this->rx_events_ != nullptr) {
+    this->read_events_();                                // whole bursts from the UART driver
+  } else {
+    while (uartAvailable(_uart) > 0) {
+      //uint8_t c = (uint8_t)uart_Read(_uart);                // read the byte for ESP8266
+      uint8_t c = (uint8_t)uartRead(_uart);                // read the byte for ESP32
+      this->arb_.last_byte = micros();
+      this->handle_char_(c);                                     // send the byte for processing
+    } //while
+  }
+
+  if (this->bench_.active) {  // the benchmark owns the bus
+    this->run_benchmark_();
+  } else if (!this->tx_buffer_.empty()) {  // if you have anything to send
+    this->tx_loop_.start();  // byte times and the gap are checked every few us, not every 16 ms
+    if (this->bus_idle_()) {
+      auto &queue = this->tx_buffer_.next();  // the highest priority with frames waiting
+      this->send_array_cmd(queue.front()); // send the first command in the queue
+      queue.pop();
     }
+  } else if (!this->arb_.exchange) {
+    this->tx_loop_.stop();
   }
 
+  this->check_register_writes_();
+  this->expire_awaited_();
+  this->poll_diagnostics_();
+  this->idle_watch_();
+  this->check_echoes_();
+  this->watchdog_();
+  this->update_travel_();
+  this->maint_loop_();
+  this->sequence_loop_();
+  this->config_loop_();
+  this->census_loop_();
+  this->trace_follow_();
+  if (current_operation != COVER_OPERATION_IDLE)
+    publish_state_if_changed();  // a position held back by the interval
+
   // Poll of current actuator position
-  if (!is_robus) {
-  
-  now = millis();
-  if (init_ok && (current_operation != COVER_OPERATION_IDLE) && (now - last_position_time > POSITION_UPDATE_INTERVAL)) {
+  uint32_t now = millis();
+  if (this->drive_->poll_position && init_ok && (current_operation != COVER_OPERATION_IDLE) &&
+      (now - last_position_time > POSITION_UPDATE_INTERVAL)) {
     last_position_time = now;
     request_position();
-  } 
-  } // not robus
+  }
 
+  this->metrics_.tx_queue_depth = this->tx_buffer_.size();
+  if (this->metrics_.tx_queue_depth > this->metrics_.tx_queue_high_water)
+    this->metrics_.tx_queue_high_water = this->metrics_.tx_queue_depth;
+  this->metrics_.loop_time.add(micros() - loop_start);
 } //loop
 
 
+void NiceBusT4::open_uart_() {
+  _uart = uartBegin(_UART_NO, BAUD_WORK, SERIAL_8N1, RX_PIN, TX_PIN, 256, 256, false, 112);
+  this->rx_events_ = nullptr;
+  this->burst_len_ = 0;
+  uartGetEventQueue(_uart, &this->rx_events_);  // the queue of the IDF driver installed by uartBegin
+  if (this->rx_events_ != nullptr)
+    uart_set_rx_timeout(UART_NUM_1, RX_BURST_TIMEOUT);
+  ESP_LOGD(TAG, "RX framing: %s", this->rx_events_ != nullptr ? "break and RX timeout" : "header bytes");
+}
+
+// Events come in the order of the bytes: a break closes the burst before it, a data event with the timeout
+// flag closes the burst it ends
+void NiceBusT4::read_events_() {
+  uart_event_t event;
+  while (xQueueReceive(this->rx_events_, &event, 0)) {
+    switch (event.type) {
+      case UART_BREAK:
+        if (this->burst_len_ > 0)
+          this->handle_burst_();
+        break;
+      case UART_DATA: {
+        size_t room = RX_BURST_MAX - this->burst_len_;
+        size_t size = std::min(event.size, room);
+        int got = uart_read_bytes(UART_NUM_1, this->burst_ + this->burst_len_, size, 0);
+        if (got > 0)
+          this->burst_len_ += got;
+        if (event.size > room) {  // longer than any frame: noise, nothing of it is kept
+          uint8_t drop[32];
+          for (size_t left = event.size - room; left > 0; left -= std::min(left, sizeof(drop)))
+            uart_read_bytes(UART_NUM_1, drop, std::min(left, sizeof(drop)), 0);
+          this->metrics_.size_errors++;
+          this->burst_len_ = 0;
+        }
+        this->arb_.last_byte = micros();
+        if (event.timeout_flag && (this->burst_len_ > 0))
+          this->handle_burst_();
+        break;
+      }
+      case UART_FIFO_OVF:
+      case UART_BUFFER_FULL:  // bytes were lost, the events no longer match the buffer
+        ESP_LOGW(TAG, "RX overflow, input dropped");
+        uart_flush_input(UART_NUM_1);
+        xQueueReset(this->rx_events_);
+        this->burst_len_ = 0;
+        return;
+      default:  // frame errors come with the breaks
+        break;
+    }
+  }
+}
+
+// A burst normally holds one frame after the zero bytes of the break; when a break went unnoticed the next
+// frame follows directly. A bad frame drops the rest of the burst: a 55 in its payload is no frame start.
+void NiceBusT4::handle_burst_() {
+  const uint8_t *data = this->burst_;
+  uint16_t len = this->burst_len_;
+  uint16_t pos = 0;
+  this->burst_len_ = 0;
+  while (pos < len) {
+    while ((pos < len) && (data[pos] == 0x00))
+      pos++;
+    if (pos == len)
+      break;
+    const uint8_t *frame = data + pos;
+    uint16_t left = len - pos;
+    if ((frame[0] != START_CODE) || (left < 12)) {
+      ESP_LOGW(TAG, "Received burst without a frame, %u bytes", left);
+      this->metrics_.size_errors++;
+      this->frame_callback_.call(FRAME_RX, frame, std::min<uint16_t>(left, 255), FRAME_SIZE);
+      break;
+    }
+    uint8_t packet_size = frame[1];
+    uint16_t length = packet_size + 3;
+    uint8_t crc1 = (frame[2] ^ frame[3] ^ frame[4] ^ frame[5] ^ frame[6] ^ frame[7]);
+    if (frame[8] != crc1) {
+      ESP_LOGW(TAG, "Received invalid message checksum 1 %02X!=%02X", frame[8], crc1);
+      this->metrics_.crc1_errors++;
+      this->frame_callback_.call(FRAME_RX, frame, 9, FRAME_CRC1);
+      break;
+    }
+    if ((length < 12) || (length > left)) {
+      ESP_LOGW(TAG, "Received invalid message size %02X, burst of %u bytes", packet_size, left);
+      this->metrics_.size_errors++;
+      this->frame_callback_.call(FRAME_RX, frame, std::min<uint16_t>(left, 255), FRAME_SIZE);
+      break;
+    }
+    uint8_t crc2 = frame[9];
+    for (uint16_t i = 10; i < length - 2; i++)
+      crc2 ^= frame[i];
+    if (frame[length - 2] != crc2) {
+      ESP_LOGW(TAG, "Received invalid message checksum 2 %02X!=%02X", frame[length - 2], crc2);
+      this->metrics_.crc2_errors++;
+      this->frame_callback_.call(FRAME_RX, frame, length, FRAME_CRC2);
+      break;
+    }
+    if (frame[length - 1] != packet_size) {
+      ESP_LOGW(TAG, "Received invalid message size %02X!=%02X", frame[length - 1], packet_size);
+      this->metrics_.size_errors++;
+      this->frame_callback_.call(FRAME_RX, frame, length, FRAME_SIZE);
+      break;
+    }
+    this->rx_message_.assign(frame, frame + length);
+    this->frame_received_();
+    this->rx_message_.clear();
+    pos += length;
+  }
+}
+
+
 void NiceBusT4::handle_char_(uint8_t c) {
   this->rx_message_.push_back(c);                      // throw a byte at the end of the received message
   if (!this->validate_message_()) {                    // check the resulting message
@@ -195,6 +376,8 @@ bool NiceBusT4::validate_message_() {                    // checking the receive
   if (at == 9)
     if (data[9] != crc1) {
       ESP_LOGW(TAG, "Received invalid message checksum 1 %02X!=%02X", data[9], crc1);
+      this->metrics_.crc1_errors++;
+      this->frame_callback_.call(FRAME_RX, data + 1, at, FRAME_CRC1);
       return false;
     }
   // Byte 10:
@@ -212,6 +395,8 @@ bool NiceBusT4::validate_message_() {                    // checking the receive
 
   if (data[length - 1] != crc2 ) {
     ESP_LOGW(TAG, "Received invalid message checksum 2 %02X!=%02X", data[length - 1], crc2);
+    this->metrics_.crc2_errors++;
+    this->frame_callback_.call(FRAME_RX, data + 1, length, FRAME_CRC2);
     return false;
   }
 
@@ -219,6 +404,8 @@ bool NiceBusT4::validate_message_() {                    // checking the receive
   //  if (at  ==  length) {
   if (data[length] != packet_size ) {
     ESP_LOGW(TAG, "Received invalid message size %02X!=%02X", data[length], packet_size);
+    this->metrics_.size_errors++;
+    this->frame_callback_.call(FRAME_RX, data + 1, length, FRAME_SIZE);
     return false;
   }
 
@@ -226,6 +413,23 @@ bool NiceBusT4::validate_message_() {                    // checking the receive
 
  // Remove 0x00 at the beginning of the message
   rx_message_.erase(rx_message_.begin());
+  return this->frame_received_();
+}
+
+// the frame without the break byte is in rx_message_, from both the burst and the byte assembler
+bool NiceBusT4::frame_received_() {
+  if (this->drop_echo_(rx_message_))
+    return false;
+  this->metrics_.frames_rx++;
+  this->frame_callback_.call(FRAME_RX, rx_message_.data(), rx_message_.size(), FRAME_OK);
+  this->watchdog_rx_(rx_message_);
+  this->census_frame_(rx_message_);
+  this->track_reply_(rx_message_);
+  this->arbitrate_(rx_message_);
+  if (this->bench_.active && this->benchmark_reply_(rx_message_))
+    return false;
+  if (this->parse_remote_packet_(rx_message_))  // remote presses are dispatched before any logging
+    return false;
 
   // to output the package to the log
   std::string pretty_cmd = format_hex_pretty(rx_message_);
@@ -233,6 +437,7 @@ bool NiceBusT4::validate_message_() {                    // checking the receive
 
   // here we do something with the message
   parse_status_packet(rx_message_);
+  this->complete_awaited_(rx_message_);
 
   // return false to reset rx buffer
   return false;
@@ -252,6 +457,11 @@ bool NiceBusT4::validate_message_() {                    // checking the receive
 // parse the received packages
 void NiceBusT4::parse_status_packet(const std::vector<uint8_t> &data) {
   // ESP_LOGD("debug", "Wywołanie parse_status_packet");
+  this->verify_register_write_(data);
+  this->idle_watch_reply_(data);
+  this->config_reply_(data);
+  this->notify_reply_(data);
+
   if ((data[1] == 0x0d) && (data[13] == 0xFD)) { // error
     ESP_LOGE(TAG,  "Command not available for this device" );
   }
@@ -310,14 +520,19 @@ void NiceBusT4::parse_status_packet(const std::vector<uint8_t> &data) {
 
           }  // switch 16
           this->publish_state_if_changed();  // publish the status
-
+          this->update_diag_(INF_IO, &data[14], data.size() - 16);
           break; //  INF_IO
 
+        case DIAG_BB:  // bluebus devices
+        case DIAG_PAR: // other parameters
+          this->update_diag_(data[10], &data[14], data.size() - 16);
+          break;
+
 
         //encoder maximum opening position, opening, closing
 
         case MAX_OPN:
-          if (is_walky) {
+          if (this->drive_->position_format == POSITION_U8) {
             this->_max_opn = data[15];
             this->_pos_opn = data[15];
           }
@@ -340,14 +555,16 @@ void NiceBusT4::parse_status_packet(const std::vector<uint8_t> &data) {
           break;
 
         case CUR_POS:
-          if (is_walky)
+          if (this->drive_->position_format == POSITION_U8) {
             update_position(data[15]);
-          else
-            uint16_t pos = (data[14] << 8) + data[15];
-            current_position = (data[14] << 8) + data[15];
+          } else {
+            update_position((data[14] << 8) + data[15]);
+          }
           break;
 
-        case INF_STATUS:
+        case INF_STATUS: {
+          // an idle probe that finds the gate as it was brings no new position, only a stop is worth a CUR_POS
+          bool news = (this->current_operation != COVER_OPERATION_IDLE) || (data[14] != this->idle_status_);
           switch (data[14]) {
             case OPENED:
               ESP_LOGI(TAG, "  The gate is open");
@@ -362,17 +579,20 @@ void NiceBusT4::parse_status_packet(const std::vector<uint8_t> &data) {
             case 0x01:
               ESP_LOGI(TAG, "  The gate is stopped");
               this->current_operation = COVER_OPERATION_IDLE;
-              request_position();
+              if (news)
+                request_position();
               break;
             case 0x00:
               ESP_LOGI(TAG, "  Gate status unknown");
               this->current_operation = COVER_OPERATION_IDLE;
-              request_position();
+              if (news)
+                request_position();
               break;
              case 0x0b:
               ESP_LOGI(TAG, "  Search for provisions done");
               this->current_operation = COVER_OPERATION_IDLE;
-              request_position();
+              if (news)
+                request_position();
               break;
               case STA_OPENING:
               ESP_LOGI(TAG, "  Opening in progress");
@@ -384,7 +604,9 @@ void NiceBusT4::parse_status_packet(const std::vector<uint8_t> &data) {
               break;
           }  // switch
           this->publish_state_if_changed();  // publish the status
+          this->notify_status_(data, data[14]);
           break;
+        }
 
           //      default: // cmd_mnu
         case AUTOCLS:
@@ -487,6 +709,7 @@ void NiceBusT4::parse_status_packet(const std::vector<uint8_t> &data) {
 
         case P_COUNT:
           this->p_count = (data[14] << 24) + (data[15] << 16) + (data[16] << 8) + data[17];
+          this->p_count_known_ = true;
           ESP_LOGCONFIG(TAG, "  Number of cycles: %u", p_count ); 
           break;
           
@@ -567,6 +790,11 @@ void NiceBusT4::parse_status_packet(const std::vector<uint8_t> &data) {
         case P_COUNT:
          tx_buffer_.push(gen_inf_cmd(FOR_CU, P_COUNT, GET)); // number of cycles
          break;
+
+        case C_MAIN:
+         ESP_LOGI(TAG, "Maintenance cancelled");
+         tx_buffer_.push(gen_inf_cmd(FOR_CU, P_COUNT, GET)); // the counter starts again
+         break;
       }// switch cmd_submnu
     }// if responses to SET requests received without errors from the drive
 
@@ -574,57 +802,32 @@ void NiceBusT4::parse_status_packet(const std::vector<uint8_t> &data) {
 
       switch (data[10]) {
         case MAN:
-          //       ESP_LOGCONFIG(TAG, "  Manufacturer: %S ", str.c_str());
-          this->manufacturer_.assign(this->rx_message_.begin() + 14, this->rx_message_.end() - 2);
+          this->identity_.set(ID_MANUFACTURER, data.data() + 14, data.size() - 16);
           break;
         case PRD:
-          if ((this->addr_oxi[0] == data[4]) && (this->addr_oxi[1] == data[5])) { // if the packet is from the receiver
-//            ESP_LOGCONFIG(TAG, "  Receiver: %S ", str.c_str());
-            this->oxi_product.assign(this->rx_message_.begin() + 14, this->rx_message_.end() - 2);
-          } // if the packet is from the receiver
-          else if ((this->addr_to[0] == data[4]) && (this->addr_to[1] == data[5])) { // if the package is from the drive controller
-//            ESP_LOGCONFIG(TAG, "  Drive unit: %S ", str.c_str());
-            this->product_.assign(this->rx_message_.begin() + 14, this->rx_message_.end() - 2);
-            std::vector<uint8_t> wla1 = {0x57,0x4C,0x41,0x31,0x00,0x06,0x57}; // to understand that Walky drive
-            std::vector<uint8_t> ROBUSHSR10 = {0x52,0x4F,0x42,0x55,0x53,0x48,0x53,0x52,0x31,0x30,0x00}; // to understand that the ROBUSHSR10 drive
-            if (this->product_ == wla1) { 
-              this->is_walky = true;
-         //     ESP_LOGCONFIG(TAG, "  WALKY drive!: %S ", str.c_str());
-                                        }
-            if (this->product_ == ROBUSHSR10) { 
-              this->is_robus = true;
-          //    ESP_LOGCONFIG(TAG, "  Drive unit ROBUS!: %S ", str.c_str());
-                                        }     
-
+          this->set_identity_(ID_PRODUCT, ID_OXI_PRODUCT, data);
+          if ((this->addr_to[0] == data[4]) && (this->addr_to[1] == data[5]) && !this->drive_fixed_) { // from the drive
+            for (const auto &profile : DRIVE_PROFILES) {
+              if ((profile.product_hash != 0) && (profile.product_hash == this->identity_.product_hash) &&
+                  (this->drive_ != &profile)) {
+                this->drive_ = &profile;
+                ESP_LOGI(TAG, "Drive profile: %s", profile.name);
+              }
+            }
           }
           break;
         case HWR:
-          if ((this->addr_oxi[0] == data[4]) && (this->addr_oxi[1] == data[5])) { // if the packet is from the receiver
-            this->oxi_hardware.assign(this->rx_message_.begin() + 14, this->rx_message_.end() - 2);
-          }
-          else if ((this->addr_to[0] == data[4]) && (this->addr_to[1] == data[5])) { // if the package is from the drive controller          
-          this->hardware_.assign(this->rx_message_.begin() + 14, this->rx_message_.end() - 2);
-          } //else
+          this->set_identity_(ID_HARDWARE, ID_OXI_HARDWARE, data);
           break;
         case FRM:
-          if ((this->addr_oxi[0] == data[4]) && (this->addr_oxi[1] == data[5])) { // if the packet is from the receiver
-            this->oxi_firmware.assign(this->rx_message_.begin() + 14, this->rx_message_.end() - 2);
-          }
-          else if ((this->addr_to[0] == data[4]) && (this->addr_to[1] == data[5])) { // if the package is from the drive controller          
-            this->firmware_.assign(this->rx_message_.begin() + 14, this->rx_message_.end() - 2);
-          } //else
+          this->set_identity_(ID_FIRMWARE, ID_OXI_FIRMWARE, data);
           break;
         case DSC:
-          if ((this->addr_oxi[0] == data[4]) && (this->addr_oxi[1] == data[5])) { // if the packet is from the receiver
-            this->oxi_description.assign(this->rx_message_.begin() + 14, this->rx_message_.end() - 2);
-          }
-          else if ((this->addr_to[0] == data[4]) && (this->addr_to[1] == data[5])) { // if the package is from the drive controller          
-            this->description_.assign(this->rx_message_.begin() + 14, this->rx_message_.end() - 2);
-          } //else
+          this->set_identity_(ID_DESCRIPTION, ID_OXI_DESCRIPTION, data);
           break;
-        case WHO:
-          if (data[12] == 0x01) {
-            if (data[14] == 0x04) { // drive unit
+        case WHO:  // census WHO replies only go to census_frame_, the addresses are set by discovery
+          if ((data[12] == 0x01) && (!this->init_ok || (millis() - this->discovery_time_ < DISCOVERY_WINDOW))) {
+            if ((data[14] == 0x04) && !this->init_ok) { // drive unit, the first one to answer
               this->addr_to[0] = data[4];
               this->addr_to[1] = data[5];
               this->init_ok = true;
@@ -645,10 +848,6 @@ void NiceBusT4::parse_status_packet(const std::vector<uint8_t> &data) {
       ESP_LOGCONFIG(TAG, "Remote control number: %X%X%X%X, command: %X, button: %X, mode: %X, click counter: %d", vec_data[5], vec_data[4], vec_data[3], vec_data[2], vec_data[8] / 0x10, vec_data[5] / 0x10, vec_data[7] + 0x01, vec_data[6]);
     }  // if
 
-    if ((data[9] == 0x0A) &&  (data[10] == 0x26) &&  (data[11] == 0x41) &&  (data[12] == 0x08) &&  (data[13] == NOERR)) { //  packets from the receiver with information about the remote control button read
-      ESP_LOGCONFIG(TAG, "button %X, remote control number: %X%X%X%X", vec_data[0] / 0x10, vec_data[0] % 0x10, vec_data[1], vec_data[2], vec_data[3]);
-    }  // if
-
   } //  if evt
 
 
@@ -720,7 +919,7 @@ void NiceBusT4::parse_status_packet(const std::vector<uint8_t> &data) {
             this->current_operation = COVER_OPERATION_IDLE;
             this->position = COVER_OPEN;
             // calibrate opened position if the motor does not report max supported position (Road 400)
-                  if (this->_max_opn == 0) {
+                  if ((this->_max_opn == 0) && (this->_pos_usl > this->_pos_cls)) {  // only after the drive reported positions
                     this->_max_opn = this->_pos_opn = this->_pos_usl;
                     ESP_LOGI(TAG, "Opened position calibrated");
                   }
@@ -738,20 +937,19 @@ void NiceBusT4::parse_status_packet(const std::vector<uint8_t> &data) {
           default:
             ESP_LOGI(TAG, "Unknown operation: %X", data[11]);
         }  // switch sub_run_cmd2
+        this->notify_status_(data, data[11]);
       }
       this->publish_state_if_changed();  // publish the status
             break; //RUN
 
           case STA:
             ESP_LOGI(TAG,  "Submenu Status in motion" );
-            switch (data[11]) { // sub_run_cmd2
+            switch (this->drive_->sta(data[11])) { // sub_run_cmd2
               case STA_OPENING:
-              case 0x83: // Road 400
                 ESP_LOGI(TAG, "Movement: Opens" );
                 this->current_operation = COVER_OPERATION_OPENING;
                 break;
               case STA_CLOSING:
-              case 0x84: // Road 400
                 ESP_LOGI(TAG,  "Movement: Closes" );
                 this->current_operation = COVER_OPERATION_CLOSING;
                 break;
@@ -777,6 +975,7 @@ void NiceBusT4::parse_status_packet(const std::vector<uint8_t> &data) {
             } // switch sub_run_cmd2
 
             update_position((data[12] << 8) + data[13]);
+            this->notify_status_(data, this->drive_->sta(data[11]));
             break; //STA
 
           default: // sub_inf_cmd
@@ -929,6 +1128,775 @@ void NiceBusT4::parse_status_packet(const std::vector<uint8_t> &data) {
 
 
 
+// remember a request addressed to one device, broadcasts get many replies and are not timed
+void NiceBusT4::track_request_(const uint8_t *data, size_t len) {
+  if ((len < 12) || (data[0] != START_CODE) || (data[3] == 0xFF))
+    return;
+  if ((data[6] == INF) && (data[11] != GET))
+    return;
+  uint32_t now = millis();
+  PendingRequest *slot = nullptr;  // a free slot, otherwise the oldest request
+  for (auto &pending : this->pending_) {
+    if (pending.active && (now - pending.time > REPLY_TIMEOUT)) {  // nobody answered
+      pending.active = false;
+      this->metrics_.lost_replies++;
+    }
+    if ((slot == nullptr) || (slot->active && (!pending.active || (int32_t) (pending.time - slot->time) < 0)))
+      slot = &pending;
+  }
+  if (slot->active)
+    this->metrics_.lost_replies++;
+  slot->active = true;
+  slot->addr[0] = data[2];
+  slot->addr[1] = data[3];
+  slot->mes_type = data[6];
+  slot->submenu = data[10];
+  slot->time = now;
+}
+
+static uint32_t frame_hash(const uint8_t *data, size_t len) {
+  uint32_t hash = 2166136261UL;
+  for (size_t i = 0; i < len; i++) {
+    hash ^= data[i];
+    hash *= 16777619UL;
+  }
+  return hash;
+}
+
+void NiceBusT4::remember_sent_(const uint8_t *data, size_t len) {
+  SentFrame &sent = this->sent_[this->sent_next_];
+  this->sent_next_ = (this->sent_next_ + 1) % ECHO_FRAMES;
+  if (sent.active)  // overwritten before its echo came
+    this->echo_missing_frame_();
+  sent.active = true;
+  sent.len = len;
+  sent.hash = frame_hash(data, len);
+  sent.time = millis();
+}
+
+bool NiceBusT4::drop_echo_(const std::vector<uint8_t> &data) {
+  uint32_t hash = frame_hash(data.data(), data.size());
+  for (auto &sent : this->sent_) {
+    if (!sent.active || (sent.len != data.size()) || (sent.hash != hash))
+      continue;
+    sent.active = false;
+    this->metrics_.echoes++;
+    if (!this->echo_seen_)
+      ESP_LOGI(TAG, "Own frames are echoed by the line, echoes confirm transmission");
+    if (this->echo_missing_ >= ECHO_MISSING_WARN)
+      ESP_LOGI(TAG, "Transmission confirmed again");
+    this->echo_seen_ = true;
+    this->echo_missing_ = 0;
+    return true;
+  }
+  return false;
+}
+
+void NiceBusT4::check_echoes_() {
+  uint32_t now = millis();
+  for (auto &sent : this->sent_) {
+    if (sent.active && (now - sent.time >= ECHO_TIMEOUT)) {
+      sent.active = false;
+      this->echo_missing_frame_();
+    }
+  }
+}
+
+void NiceBusT4::echo_missing_frame_() {
+  if (!this->echo_seen_)  // the wiring does not echo, nothing to confirm
+    return;
+  this->metrics_.missing_echoes++;
+  if ((this->echo_missing_ < ECHO_MISSING_WARN) && (++this->echo_missing_ == ECHO_MISSING_WARN))
+    ESP_LOGW(TAG, "No echo of the last %u frames, check the transmitter", ECHO_MISSING_WARN);
+}
+
+void NiceBusT4::watchdog_() {
+  uint32_t now = millis();
+  size_t queued = this->tx_buffer_.size();
+  if (queued <= WD_QUEUE_LIMIT)
+    this->wd_.queue_since = 0;
+  else if (this->wd_.queue_since == 0)
+    this->wd_.queue_since = now;
+  if (this->wd_.level > 0) {  // the last step, discovery, repeats on its own every 10 s
+    if ((this->wd_.level < WD_LEVELS) && (now - this->wd_.last_step >= WD_STEP_TIME))
+      this->watchdog_step_();
+    return;
+  }
+  if (this->bench_.active)
+    return;
+  const char *fault = nullptr;
+  uint32_t silence = now - this->wd_.last_rx;
+  if ((this->wd_.queue_since != 0) && (now - this->wd_.queue_since >= WD_QUEUE_TIME))
+    fault = "TX queue keeps growing";
+  else if (this->init_ok && ((int32_t) (this->wd_.last_tx - this->wd_.last_rx) > 0) && (silence >= WD_REPLY_SILENCE))
+    fault = "the drive does not answer";
+  else if (this->init_ok && this->drive_->poll_position && (current_operation != COVER_OPERATION_IDLE) && (silence >= WD_MOVING_SILENCE))
+    fault = "no frames while the gate moves";
+  if (fault == nullptr)
+    return;
+  ESP_LOGW(TAG, "Bus fault: %s, %u frames queued", fault, (unsigned) queued);
+  this->status_set_warning("Bus T4 fault");
+  this->wd_.since = now;
+  this->watchdog_step_();
+}
+
+void NiceBusT4::watchdog_step_() {
+  this->wd_.last_step = millis();
+  this->wd_.level++;
+  switch (this->wd_.level) {
+    case 1:
+      ESP_LOGW(TAG, "Recovery: re-sync of the frame assembler");
+      this->rx_message_.clear();
+      this->burst_len_ = 0;
+      while (uartAvailable(_uart) > 0)
+        uartRead(_uart);
+      if (this->rx_events_ != nullptr)
+        xQueueReset(this->rx_events_);  // the events of the bytes just dropped
+      break;
+    case 2:
+      ESP_LOGW(TAG, "Recovery: UART restart");
+      uartEnd(_uart);
+      this->open_uart_();
+      this->rx_message_.clear();
+      break;
+    default:
+      ESP_LOGW(TAG, "Recovery: discovery of the drive");
+      this->tx_buffer_.clear();
+      this->wd_.queue_since = 0;
+      this->init_ok = false;
+      this->last_update_ = millis() - 10000;  // WHO and PRD go out in this loop
+      break;
+  }
+}
+
+void NiceBusT4::watchdog_rx_(const std::vector<uint8_t> &data) {
+  if ((data.size() < 6) || (data[4] != this->addr_to[0]) || (data[5] != this->addr_to[1]))
+    return;
+  uint32_t now = millis();
+  this->wd_.last_rx = now;
+  if (this->wd_.level == 0)
+    return;
+  this->metrics_.recoveries++;
+  this->metrics_.recovery_time = now - this->wd_.since;
+  ESP_LOGI(TAG, "Bus recovered after %u ms, recovery step %u", this->metrics_.recovery_time, this->wd_.level);
+  this->wd_.level = 0;
+  this->status_clear_warning();
+}
+
+bool NiceBusT4::bus_idle_() {
+  if (this->arb_.exchange) {
+    if (millis() - this->arb_.exchange_start < ARB_REPLY_WAIT)
+      return false;
+    this->arb_.exchange = false;  // no reply, the bus is free again
+  }
+  return micros() - this->arb_.last_byte >= this->tx_gap_ + this->arb_.backoff;
+}
+
+void NiceBusT4::arbitrate_(const std::vector<uint8_t> &data) {
+  if (data.size() < 12)
+    return;
+  if ((data[4] == this->addr_from[0]) && (data[5] == this->addr_from[1]))
+    return;  // our own frame
+  bool request = ((data[6] == CMD) && (data[10] == RUN)) ||
+                 ((data[6] == INF) && ((data[11] == GET) || (data[11] == SET) || (data[11] == GET_SUPP_CMD)));
+  if (request) {  // another master took the bus, wait for the reply and a little more
+    this->metrics_.other_requests++;
+    this->arb_.exchange = true;
+    this->arb_.exchange_addr[0] = data[2];
+    this->arb_.exchange_addr[1] = data[3];
+    this->arb_.exchange_start = millis();
+    this->arb_.backoff = (random_uint32() % (ARB_BACKOFF_CHARS + 1)) * CHAR_TIME;
+    this->arb_.foreign = true;
+    return;
+  }
+  if (this->arb_.exchange && (data[4] == this->arb_.exchange_addr[0]) && (data[5] == this->arb_.exchange_addr[1]))
+    this->arb_.exchange = false;  // the reply ends the exchange
+}
+
+// CMD is answered with RSP of the RUN submenu, INF GET with EVT of the same submenu
+void NiceBusT4::track_reply_(const std::vector<uint8_t> &data) {
+  if (data.size() < 14)
+    return;
+  for (auto &pending : this->pending_) {
+    if (!pending.active || (pending.addr[0] != data[4]) || (pending.addr[1] != data[5]) || (pending.mes_type != data[6]))
+      continue;
+    bool is_rsp = (data[6] == CMD) && (data[10] == RUN - 0x80);
+    bool is_evt = (data[6] == INF) && (data[10] == pending.submenu) && ((data[11] == GET - 0x80) || (data[11] == GET - 0x81));
+    if (!is_rsp && !is_evt)
+      continue;
+    pending.active = false;
+    DeviceLatency *device = this->device_latency_(data[4], data[5]);
+    if (device != nullptr)
+      (is_rsp ? device->rsp : device->evt).add(millis() - pending.time);
+    return;
+  }
+}
+
+DeviceLatency *NiceBusT4::device_latency_(uint8_t addr1, uint8_t addr2) {
+  for (auto &device : this->metrics_.devices) {
+    if ((device.addr[0] == addr1) && (device.addr[1] == addr2))
+      return &device;
+    if ((device.addr[0] == 0) && (device.addr[1] == 0)) {  // first reply from this device
+      device.addr[0] = addr1;
+      device.addr[1] = addr2;
+      return &device;
+    }
+  }
+  return nullptr;  // table full
+}
+
+const DeviceLatency *NiceBusT4::get_device_latency(uint16_t address) const {
+  for (auto &device : this->metrics_.devices) {
+    if ((device.addr[0] == (address >> 8)) && (device.addr[1] == (address & 0xFF)))
+      return &device;
+  }
+  return nullptr;
+}
+
+// SET and the verifying GET are queued back to back, a write to the same register replaces the previous one
+void NiceBusT4::set_register(uint8_t reg, uint32_t value, uint8_t len, std::function<void(uint8_t)> &&done) {
+  RegisterWrite *slot = nullptr;
+  std::function<void(uint8_t)> replaced;
+  uint8_t stale = 0;
+  for (auto &write : this->writes_) {
+    if (write.active && (write.reg == reg)) {  // its frames are still queued, their replies are not for this value
+      replaced = std::move(write.done);
+      stale = write.stale + write.pending;
+      slot = &write;
+      break;
+    }
+    if (!write.active && (slot == nullptr))
+      slot = &write;
+  }
+  if (slot == nullptr) {
+    ESP_LOGW(TAG, "Too many register writes, %02X not written", reg);
+    if (done)
+      done(AWAIT_ERROR);
+    return;
+  }
+  slot->active = true;
+  slot->reg = reg;
+  slot->len = std::min<uint8_t>(std::max<uint8_t>(len, 1), 4);
+  slot->value = value;
+  slot->retries = REGISTER_WRITE_RETRIES;
+  slot->pending = 0;
+  slot->stale = stale;
+  slot->done = std::move(done);
+  this->send_register_write_(*slot);
+  if (replaced) {  // last, it may start another write
+    ESP_LOGD(TAG, "Register %02X: write replaced", reg);
+    replaced(AWAIT_ERROR);
+  }
+}
+
+// set_register() would take a slot for this register now
+bool NiceBusT4::register_write_free_(uint8_t reg) const {
+  for (auto &write : this->writes_) {
+    if (!write.active || (write.reg == reg))
+      return true;
+  }
+  return false;
+}
+
+void NiceBusT4::send_register_write_(RegisterWrite &write) {
+  std::vector<uint8_t> value(write.len);
+  for (uint8_t i = 0; i < write.len; i++)
+    value[i] = write.value >> (8 * (write.len - 1 - i));
+  this->tx_buffer_.push(gen_inf_cmd(FOR_CU, write.reg, SET, 0x00, value));
+  this->tx_buffer_.push(gen_inf_cmd(FOR_CU, write.reg, GET));
+  write.pending++;
+  // the timeout starts when both frames are expected to be on the bus
+  write.deadline = millis() + this->tx_buffer_.size() * (this->tx_gap_ / 1000 + ARB_REPLY_WAIT) + REGISTER_WRITE_TIMEOUT;
+}
+
+void NiceBusT4::verify_register_write_(const std::vector<uint8_t> &data) {
+  if ((data.size() < 14) || (data[6] != INF) || (data[9] != FOR_CU) || (data[4] != this->addr_to[0]) ||
+      (data[5] != this->addr_to[1]))
+    return;
+  for (auto &write : this->writes_) {
+    if (!write.active || (write.reg != data[10]))
+      continue;
+    if (write.stale > 0) {  // SET and GET replies of the replaced write come first
+      if (data[11] == GET - 0x80)
+        write.stale--;
+      return;
+    }
+    if ((data[11] == GET - 0x80) && (write.pending > 0))
+      write.pending--;
+    if ((data[11] == SET - 0x80) && (data[13] != NOERR)) {  // the drive refused the value
+      ESP_LOGW(TAG, "Register %02X: SET refused, error %02X", write.reg, data[13]);
+      this->finish_register_write_(write, AWAIT_ERROR);
+    } else if (data[11] == GET - 0x80) {
+      if ((data[13] != NOERR) || (data.size() < 16u + write.len)) {
+        ESP_LOGW(TAG, "Register %02X: GET failed, error %02X", write.reg, data[13]);
+        this->finish_register_write_(write, AWAIT_ERROR);
+        return;
+      }
+      uint32_t value = 0;
+      for (uint8_t i = 0; i < write.len; i++)
+        value = (value << 8) | data[14 + i];
+      if (value == write.value) {
+        this->finish_register_write_(write, AWAIT_OK);
+      } else if (write.retries > 0) {
+        ESP_LOGW(TAG, "Register %02X: read back %u instead of %u, retrying", write.reg, value, write.value);
+        write.retries--;
+        this->send_register_write_(write);
+      } else {
+        ESP_LOGW(TAG, "Register %02X: read back %u instead of %u", write.reg, value, write.value);
+        this->finish_register_write_(write, AWAIT_ERROR);
+      }
+    }
+    return;
+  }
+}
+
+void NiceBusT4::check_register_writes_() {
+  uint32_t now = millis();
+  for (auto &write : this->writes_) {
+    if (!write.active || ((int32_t) (now - write.deadline) < 0))
+      continue;
+    if (write.retries > 0) {
+      ESP_LOGW(TAG, "Register %02X: no confirmation, retrying", write.reg);
+      write.retries--;
+      write.pending = 0;  // the replies were lost
+      write.stale = 0;
+      this->send_register_write_(write);
+    } else {
+      ESP_LOGW(TAG, "Register %02X: no confirmation", write.reg);
+      this->finish_register_write_(write, AWAIT_TIMEOUT);
+    }
+  }
+}
+
+void NiceBusT4::finish_register_write_(RegisterWrite &write, uint8_t result) {
+  write.active = false;
+  if (result == AWAIT_OK)
+    ESP_LOGD(TAG, "Register %02X = %u confirmed", write.reg, write.value);
+  if (write.done) {
+    auto done = std::move(write.done);  // the callback may start the next write
+    write.done = nullptr;
+    done(result);
+  }
+}
+
+bool NiceBusT4::send_awaited(std::vector<uint8_t> &&frame, uint8_t priority, uint32_t timeout, AwaitCallback &&done) {
+  if (frame.size() < 12)
+    return false;
+  AwaitedRequest *slot = nullptr;
+  for (auto &awaited : this->awaited_) {
+    if (!awaited.active) {
+      slot = &awaited;
+      break;
+    }
+  }
+  if (slot == nullptr) {
+    ESP_LOGW(TAG, "Too many awaited requests");
+    return false;
+  }
+  AwaitedRequest request{true, {frame[2], frame[3]}, frame[6], frame[10], frame[11], 0, nullptr};
+  if (!this->tx_buffer_.push(std::move(frame), priority))
+    return false;
+  // like register writes, the timeout starts when the frame is expected to be on the bus
+  request.deadline = millis() + this->tx_buffer_.size() * (this->tx_gap_ / 1000 + ARB_REPLY_WAIT) + timeout;
+  request.done = std::move(done);
+  *slot = std::move(request);
+  return true;
+}
+
+void NiceBusT4::complete_awaited_(const std::vector<uint8_t> &data) {
+  if (data.size() < 16)
+    return;
+  for (auto &awaited : this->awaited_) {
+    if (!awaited.active || (awaited.mes_type != data[6]))
+      continue;
+    if ((awaited.addr[1] != 0xFF) && ((awaited.addr[0] != data[4]) || (awaited.addr[1] != data[5])))
+      continue;
+    uint8_t result = AWAIT_OK;
+    if (awaited.mes_type == CMD) {
+      // RUN statuses of the maneuver share the submenu, the acknowledgement repeats the command + 0x80
+      if (data[10] != awaited.submenu - 0x80)
+        continue;
+      if ((awaited.submenu == RUN) && (data[11] != (uint8_t) (awaited.run + 0x80)))
+        continue;
+      if (data[13] != NOERR)  // 0xFD - the command is not available
+        result = AWAIT_ERROR;
+    } else {
+      bool more = (awaited.run == GET) && (data[11] == GET - 0x81);  // first part of a long answer
+      if ((data[10] != awaited.submenu) || ((data[11] != awaited.run - 0x80) && !more))
+        continue;
+      if (data[13] != NOERR)
+        result = AWAIT_ERROR;
+    }
+    awaited.active = false;
+    auto done = std::move(awaited.done);  // the callback may await the next request
+    awaited.done = nullptr;
+    done(result, &data);
+    return;
+  }
+}
+
+void NiceBusT4::expire_awaited_() {
+  uint32_t now = millis();
+  for (auto &awaited : this->awaited_) {
+    if (!awaited.active || ((int32_t) (now - awaited.deadline) < 0))
+      continue;
+    awaited.active = false;
+    auto done = std::move(awaited.done);
+    awaited.done = nullptr;
+    done(AWAIT_TIMEOUT, nullptr);
+  }
+}
+
+
+// Bus benchmark.
+// Gap sweep: GET, wait for EVT (or timeout), stay silent for the gap, next GET - finds the shortest gap the drive tolerates.
+// Rate sweep: GETs at a fixed rate regardless of replies - finds the highest rate without loss or CRC errors.
+// Each phase stops at the first stage that loses a reply or sees a corrupted frame.
+void NiceBusT4::start_benchmark(uint8_t reg, uint16_t count, bool apply) {
+  if (this->bench_.active) {
+    ESP_LOGW(TAG, "Benchmark already running");
+    return;
+  }
+  if (!this->init_ok || (this->current_operation != COVER_OPERATION_IDLE)) {
+    ESP_LOGW(TAG, "Benchmark needs a detected drive at rest");
+    return;
+  }
+  this->bench_ = Benchmark{};
+  this->bench_.reg = reg;
+  this->bench_.regs[0] = reg;
+  uint8_t slots = 1;
+  for (uint8_t other : BENCH_REGISTERS) {
+    if ((other != reg) && (slots < BENCH_INFLIGHT))
+      this->bench_.regs[slots++] = other;
+  }
+  this->bench_.count = std::max<uint16_t>(count, 1);
+  this->bench_.apply = apply;
+  this->bench_.active = true;
+  this->bench_.errors_start = this->metrics_.crc1_errors + this->metrics_.crc2_errors + this->metrics_.size_errors;
+  this->bench_.last_rx = millis();
+  this->bench_.next_send = millis();
+  this->quiet_ = true;
+  this->bench_loop_.start();
+  ESP_LOGI(TAG, "Benchmark of register %02X, %u GETs per stage", reg, this->bench_.count);
+}
+
+void NiceBusT4::benchmark_send_(uint8_t slot) {
+  Benchmark &b = this->bench_;
+  if (b.pending[slot]) {  // not answered within BENCH_INFLIGHT later GETs, as good as lost
+    b.pending[slot] = false;
+    b.inflight--;
+  }
+  std::vector<uint8_t> frame = gen_inf_cmd(FOR_CU, b.regs[slot], GET);
+  this->send_array_cmd(frame);
+  b.pending[slot] = true;
+  b.sent_at[slot] = millis();
+  b.inflight++;
+  b.sent++;
+}
+
+// the sweeps keep their own gaps and rates, they only wait out frames on the line and other masters,
+// so a collision is not counted as a loss of the drive
+bool NiceBusT4::benchmark_line_free_() {
+  if (this->arb_.exchange && this->arb_.foreign) {
+    if (millis() - this->arb_.exchange_start < ARB_REPLY_WAIT)
+      return false;
+    this->arb_.exchange = false;
+  }
+  return micros() - this->arb_.last_byte >= BENCH_LINE_SILENCE + this->arb_.backoff;
+}
+
+void NiceBusT4::run_benchmark_() {
+  Benchmark &b = this->bench_;
+  uint32_t now = millis();
+
+  // forget GETs that will not be answered any more
+  for (uint8_t slot = 0; slot < BENCH_INFLIGHT; slot++) {
+    if (b.pending[slot] && (now - b.sent_at[slot] > BENCH_TIMEOUT)) {
+      b.pending[slot] = false;
+      b.inflight--;
+      b.last_rx = now;
+    }
+  }
+
+  if (b.sent < b.count) {
+    if (!b.rate_phase) {
+      if ((b.inflight == 0) && (now - b.last_rx >= BENCH_GAPS[b.stage]) && this->benchmark_line_free_())
+        this->benchmark_send_(0);
+    } else if (((int32_t) (now - b.next_send) >= 0) && this->benchmark_line_free_()) {
+      this->benchmark_send_(b.next_slot);
+      b.next_slot = (b.next_slot + 1) % BENCH_INFLIGHT;
+      b.next_send += 1000 / BENCH_RATES[b.stage];
+    }
+  } else if (b.inflight == 0) {
+    this->finish_benchmark_stage_();
+  }
+}
+
+bool NiceBusT4::benchmark_reply_(const std::vector<uint8_t> &data) {
+  Benchmark &b = this->bench_;
+  if ((data.size() < 14) || (data[4] != this->addr_to[0]) || (data[5] != this->addr_to[1]) || (data[6] != INF) ||
+      (data[11] != GET - 0x80))
+    return false;
+  uint8_t slot = 0;
+  while ((slot < BENCH_INFLIGHT) && (b.regs[slot] != data[10]))
+    slot++;
+  if (slot == BENCH_INFLIGHT)
+    return false;
+  uint32_t now = millis();
+  b.last_rx = now;
+  if (!b.pending[slot])  // late reply to a GET already counted as lost
+    return true;
+  uint32_t rtt = now - b.sent_at[slot];
+  b.pending[slot] = false;
+  b.inflight--;
+  b.received++;
+  if (b.samples < BENCH_SAMPLES)
+    b.rtt[b.samples++] = std::min<uint32_t>(rtt, 0xFFFF);
+  return true;
+}
+
+void NiceBusT4::finish_benchmark_stage_() {
+  Benchmark &b = this->bench_;
+  BenchStage &result = b.rate_phase ? b.rates[b.stage] : b.gaps[b.stage];
+  uint32_t errors = this->metrics_.crc1_errors + this->metrics_.crc2_errors + this->metrics_.size_errors;
+  result.param = b.rate_phase ? BENCH_RATES[b.stage] : BENCH_GAPS[b.stage];
+  result.sent = b.sent;
+  result.received = b.received;
+  result.errors = errors - b.errors_start;
+  if (b.samples > 0) {
+    std::sort(b.rtt, b.rtt + b.samples);
+    result.rtt_p50 = b.rtt[(b.samples - 1) / 2];
+    result.rtt_p95 = b.rtt[(b.samples * 95 - 1) / 100];
+    result.rtt_max = b.rtt[b.samples - 1];
+  }
+  ESP_LOGI(TAG, "Benchmark %s %u: %u/%u replies, %u errors, rtt p50 %u p95 %u max %u ms", b.rate_phase ? "rate" : "gap",
+           result.param, result.received, result.sent, result.errors, result.rtt_p50, result.rtt_p95, result.rtt_max);
+
+  bool last = b.rate_phase ? (b.stage + 1 == BENCH_RATE_STAGES) : (b.stage + 1 == BENCH_GAP_STAGES);
+  if (b.rate_phase)
+    b.rate_stages++;
+  else
+    b.gap_stages++;
+  if (result.passed() && !last) {
+    b.stage++;
+  } else if (!b.rate_phase) {
+    b.rate_phase = true;
+    b.stage = 0;
+  } else {
+    this->report_benchmark_();
+    return;
+  }
+  b.sent = b.received = b.samples = 0;
+  b.errors_start = errors;
+  b.next_send = b.last_rx = millis();
+}
+
+// JSON report for automations, the shortest gap and the highest rate are those of the last passed stages
+void NiceBusT4::report_benchmark_() {
+  Benchmark &b = this->bench_;
+  uint8_t min_gap = 0;
+  uint8_t max_rate = 0;
+  for (uint8_t i = 0; i < b.gap_stages && b.gaps[i].passed(); i++)
+    min_gap = b.gaps[i].param;
+  for (uint8_t i = 0; i < b.rate_stages && b.rates[i].passed(); i++)
+    max_rate = b.rates[i].param;
+
+  std::string report;
+  char buf[128];
+  snprintf(buf, sizeof(buf), "{\"register\":%u,\"count\":%u,\"min_gap\":%u,\"max_rate\":%u,\"gaps\":[", b.reg, b.count,
+           min_gap, max_rate);
+  report += buf;
+  for (uint8_t i = 0; i < b.gap_stages + b.rate_stages; i++) {
+    bool rate = i >= b.gap_stages;
+    const BenchStage &st = rate ? b.rates[i - b.gap_stages] : b.gaps[i];
+    if (i == b.gap_stages)
+      report += "],\"rates\":[";
+    snprintf(buf, sizeof(buf), "%s{\"%s\":%u,\"sent\":%u,\"received\":%u,\"errors\":%u,\"p50\":%u,\"p95\":%u,\"max\":%u}",
+             (i == 0 || i == b.gap_stages) ? "" : ",", rate ? "rate" : "gap", st.param, st.sent, st.received, st.errors,
+             st.rtt_p50, st.rtt_p95, st.rtt_max);
+    report += buf;
+  }
+  report += "]}";
+
+  b.active = false;
+  this->quiet_ = false;
+  this->bench_loop_.stop();
+  this->arb_.last_byte = micros();
+  ESP_LOGI(TAG, "Benchmark done: %s", report.c_str());
+  if (b.apply && (min_gap > 0)) {
+    this->tx_gap_ = 2000 * min_gap;  // keep a margin to the tolerated limit
+    ESP_LOGI(TAG, "Inter-frame gap set to %u us", this->tx_gap_);
+  }
+  this->benchmark_callback_.call(report);
+}
+
+
+bool NiceBusT4::add_listener(BusT4Listener *listener) {
+  if (this->listener_count_ == MAX_LISTENERS) {
+    ESP_LOGE(TAG, "More than %u listeners, the rest gets no updates", MAX_LISTENERS);
+    return false;
+  }
+  this->listeners_[this->listener_count_++] = listener;
+  return true;
+}
+
+// payload of a FOR_ALL reply into the drive or the receiver field, depending on the sender
+void NiceBusT4::set_identity_(uint8_t drive_field, uint8_t oxi_field, const std::vector<uint8_t> &data) {
+  if ((this->addr_oxi[0] == data[4]) && (this->addr_oxi[1] == data[5]))
+    this->identity_.set(oxi_field, data.data() + 14, data.size() - 16);
+  else if ((this->addr_to[0] == data[4]) && (this->addr_to[1] == data[5]))
+    this->identity_.set(drive_field, data.data() + 14, data.size() - 16);
+}
+
+void NiceBusT4::notify_reply_(const std::vector<uint8_t> &data) {
+  if ((data.size() < 16) || (data[6] != INF))
+    return;
+  uint16_t address = (data[4] << 8) | data[5];
+  if ((data[11] == GET - 0x80) || (data[11] == GET - 0x81) || (data[11] == SET - 0x80)) {
+    if (data[13] != NOERR) {
+      for (uint8_t i = 0; i < this->listener_count_; i++)
+        this->listeners_[i]->on_error(address, data[10], data[13]);
+      return;
+    }
+  }
+  // registers of the drive only, other devices reuse the numbers
+  if ((data.size() < 17) || (data[9] != FOR_CU) || (data[11] != GET - 0x80) || (address != this->get_to_address()))
+    return;
+  for (uint8_t i = 0; i < this->listener_count_; i++)
+    this->listeners_[i]->on_register(address, data[10], &data[14], data.size() - 16);
+}
+
+void NiceBusT4::notify_status_(const std::vector<uint8_t> &data, uint8_t status) {
+  this->trace_sample_(status, -1);
+  uint16_t address = (data[4] << 8) | data[5];
+  if (address == this->get_to_address()) {
+    if (status != this->idle_status_) {  // probe again soon, the gate may keep changing
+      this->idle_status_ = status;
+      this->idle_interval_ = IDLE_WATCH_MIN;
+    }
+    this->sequence_status_(status);
+  }
+  for (uint8_t i = 0; i < this->listener_count_; i++)
+    this->listeners_[i]->on_status(address, status);
+}
+
+void NiceBusT4::watch_register(uint8_t reg) {
+  for (uint8_t i = 0; i < this->watched_count_; i++) {
+    if (this->watched_[i] == reg)
+      return;
+  }
+  if (this->watched_count_ == WATCHED_REGISTERS) {
+    ESP_LOGW(TAG, "Register %02X: more than %u registers watched", reg, WATCHED_REGISTERS);
+    return;
+  }
+  this->watched_[this->watched_count_++] = reg;
+}
+
+void NiceBusT4::refresh_registers() {
+  for (uint8_t i = 0; i < this->watched_count_; i++)
+    this->tx_buffer_.push(gen_inf_cmd(FOR_CU, this->watched_[i], GET));
+}
+
+
+// one-off read of all diagnostics registers
+void NiceBusT4::request_diagnostics() {
+  for (uint8_t i = 0; i < DIAG_COUNT; i++)
+    tx_buffer_.push(gen_inf_cmd(FOR_CU, DIAG_REGISTERS[i], GET), TX_LOW);
+}
+
+// INF_STATUS probes while the gate is idle; in motion the position polling follows the gate and the next
+// idle period starts with fast probes again
+void NiceBusT4::idle_watch_() {
+  if ((this->idle_max_ == 0) || !this->init_ok || this->bench_.active)
+    return;
+  if (this->current_operation != COVER_OPERATION_IDLE) {
+    this->idle_interval_ = IDLE_WATCH_MIN;
+    return;
+  }
+  if (!this->tx_buffer_.empty())
+    return;  // anything else we send is answered with news too
+  uint32_t now = millis();
+  if (now - this->last_idle_probe_ < this->idle_interval_)
+    return;
+  this->last_idle_probe_ = now;
+  this->tx_buffer_.push(gen_inf_cmd(FOR_CU, INF_STATUS, GET), TX_LOW);
+  this->idle_interval_ = std::min(this->idle_interval_ * 2, std::max(this->idle_max_, this->idle_spacing_));
+}
+
+// a drive without INF_STATUS refuses the probes, they are stopped
+void NiceBusT4::idle_watch_reply_(const std::vector<uint8_t> &data) {
+  if ((this->idle_max_ == 0) || (data.size() < 14) || (data[6] != INF) || (data[10] != INF_STATUS) ||
+      (data[11] != GET - 0x80) || (data[13] == NOERR) || (data[4] != this->addr_to[0]) || (data[5] != this->addr_to[1]))
+    return;
+  ESP_LOGW(TAG, "The drive does not report INF_STATUS (error %02X), idle watch stopped", data[13]);
+  this->idle_max_ = 0;
+}
+
+// diagnostics registers are polled round-robin, one GET at a time and only into an empty queue,
+// so control commands never wait behind them
+void NiceBusT4::poll_diagnostics_() {
+  if ((this->diag_subscribers_ == 0) || (this->diag_spacing_ == 0))
+    return;
+  if (!this->init_ok || !this->tx_buffer_.empty())
+    return;
+  uint32_t now = millis();
+  if (now - this->last_diag_poll_ < this->diag_spacing_)
+    return;
+  this->last_diag_poll_ = now;
+  this->tx_buffer_.push(gen_inf_cmd(FOR_CU, DIAG_REGISTERS[this->diag_next_], GET), TX_LOW);
+  this->diag_next_ = (this->diag_next_ + 1) % DIAG_COUNT;
+}
+
+// keep the raw payload and tell subscribers which bits changed; the first payload reports all bits as changed
+void NiceBusT4::update_diag_(uint8_t reg, const uint8_t *data, uint8_t len) {
+  uint8_t idx = 0;
+  while ((idx < DIAG_COUNT) && (DIAG_REGISTERS[idx] != reg))
+    idx++;
+  if (idx == DIAG_COUNT)
+    return;
+
+  DiagPayload &last = this->diag_[idx];
+  if (len > DIAG_PAYLOAD_MAX)
+    len = DIAG_PAYLOAD_MAX;
+  uint8_t changed[DIAG_PAYLOAD_MAX];
+  bool any = !last.valid || (last.len != len);
+  for (uint8_t i = 0; i < len; i++) {
+    changed[i] = (last.valid && i < last.len) ? (last.data[i] ^ data[i]) : 0xFF;
+    any |= (changed[i] != 0);
+  }
+  if (!any)
+    return;
+
+  memcpy(last.data, data, len);
+  last.len = len;
+  last.valid = true;
+  ESP_LOGD(TAG, "Diagnostics %02X changed: %s", reg, format_hex_pretty(data, len).c_str());
+  this->diag_callback_.call(reg, last.data, len, changed);
+}
+
+
+// OXI button read: 55 LL 00 FF 00 0A 08 .. crc1 | 0A 26 41 08 00 | b0 b1 b2 b3 .. | crc2 LL
+// b0 high nibble - button, b0 low nibble and b1..b3 - remote control serial number
+bool NiceBusT4::parse_remote_packet_(const std::vector<uint8_t> &data) {
+  if (data.size() < 20)
+    return false;
+  if ((data[9] != FOR_OXI) || (data[10] != 0x26) || (data[11] != 0x41) || (data[12] != 0x08) || (data[13] != NOERR))
+    return false;
+
+  RemoteEvent event;
+  event.button = data[14] >> 4;
+  event.serial = ((uint32_t)(data[14] & 0x0F) << 24) | ((uint32_t)data[15] << 16) | ((uint32_t)data[16] << 8) | data[17];
+  event.receiver[0] = data[4];
+  event.receiver[1] = data[5];
+  event.time = millis();
+  for (uint8_t i = 0; i < this->listener_count_; i++)  // listeners first, the log can wait
+    this->listeners_[i]->on_remote(event);
+
+  ESP_LOGD(TAG, "Remote control %07X, button %u", event.serial, event.button);
+  return true;
+}
+
+
 void NiceBusT4::dump_config() {    //  add information about the connected controller to the log
   ESP_LOGCONFIG(TAG, "  Bus T4 Cover");
   /*ESP_LOGCONFIG(TAG, "  Address: 0x%02X%02X", *this->header_[1], *this->header_[2]);*/
@@ -956,38 +1924,30 @@ void NiceBusT4::dump_config() {    //  add information about the connected contr
   ESP_LOGCONFIG(TAG, "  Maximum encoder or timer position: %d", this->_max_opn);
   ESP_LOGCONFIG(TAG, "  Gate open position: %d", this->_pos_opn);
   ESP_LOGCONFIG(TAG, "  Closed gate position: %d", this->_pos_cls);
+  if (this->service_interval_ > 0)
+    ESP_LOGCONFIG(TAG, "  Service interval: %u cycles", this->service_interval_);
 
-  std::string manuf_str(this->manufacturer_.begin(), this->manufacturer_.end());
-  ESP_LOGCONFIG(TAG, "  Manufacturer: %S ", manuf_str.c_str());
-
-  std::string prod_str(this->product_.begin(), this->product_.end());
-  ESP_LOGCONFIG(TAG, "  Drive unit: %S ", prod_str.c_str());
-
-  std::string hard_str(this->hardware_.begin(), this->hardware_.end());
-  ESP_LOGCONFIG(TAG, "  Drive hardware: %S ", hard_str.c_str());
-
-  std::string firm_str(this->firmware_.begin(), this->firmware_.end());
-  ESP_LOGCONFIG(TAG, "  Drive firmware: %S ", firm_str.c_str());
-  
-  std::string dsc_str(this->description_.begin(), this->description_.end());
-  ESP_LOGCONFIG(TAG, "  Drive description: %S ", dsc_str.c_str());
-
+  const DeviceIdentity &id = this->identity_;
+  ESP_LOGCONFIG(TAG, "  Manufacturer: %.*s ", id.size(ID_MANUFACTURER), id.str(ID_MANUFACTURER));
+  ESP_LOGCONFIG(TAG, "  Drive unit: %.*s ", id.size(ID_PRODUCT), id.str(ID_PRODUCT));
+  ESP_LOGCONFIG(TAG, "  Drive hardware: %.*s ", id.size(ID_HARDWARE), id.str(ID_HARDWARE));
+  ESP_LOGCONFIG(TAG, "  Drive firmware: %.*s ", id.size(ID_FIRMWARE), id.str(ID_FIRMWARE));
+  ESP_LOGCONFIG(TAG, "  Drive description: %.*s ", id.size(ID_DESCRIPTION), id.str(ID_DESCRIPTION));
+  ESP_LOGCONFIG(TAG, "  Drive profile: %s%s", this->drive_->name, this->drive_fixed_ ? " (configured)" : "");
 
   ESP_LOGCONFIG(TAG, "  Gateway address: 0x%02X%02X", addr_from[0], addr_from[1]);
   ESP_LOGCONFIG(TAG, "  Drive address: 0x%02X%02X", addr_to[0], addr_to[1]);
+  ESP_LOGCONFIG(TAG, "  Inter-frame gap: %u us, %.1f characters", tx_gap_, tx_gap_ * 1.0f / CHAR_TIME);
+  if (this->idle_max_ > 0)
+    ESP_LOGCONFIG(TAG, "  Idle watch: INF_STATUS every %u..%u ms", IDLE_WATCH_MIN, std::max(this->idle_max_, this->idle_spacing_));
   ESP_LOGCONFIG(TAG, "  Receiver address: 0x%02X%02X", addr_oxi[0], addr_oxi[1]);
   
-  std::string oxi_prod_str(this->oxi_product.begin(), this->oxi_product.end());
-  ESP_LOGCONFIG(TAG, "  Receiver: %S ", oxi_prod_str.c_str());
-  
-  std::string oxi_hard_str(this->oxi_hardware.begin(), this->oxi_hardware.end());
-  ESP_LOGCONFIG(TAG, "  Receiver hardware: %S ", oxi_hard_str.c_str());
-
-  std::string oxi_firm_str(this->oxi_firmware.begin(), this->oxi_firmware.end());
-  ESP_LOGCONFIG(TAG, "  Receiver firmware: %S ", oxi_firm_str.c_str());
-  
-  std::string oxi_dsc_str(this->oxi_description.begin(), this->oxi_description.end());
-  ESP_LOGCONFIG(TAG, "  Receiver Description: %S ", oxi_dsc_str.c_str());
+  ESP_LOGCONFIG(TAG, "  Receiver: %.*s ", id.size(ID_OXI_PRODUCT), id.str(ID_OXI_PRODUCT));
+  ESP_LOGCONFIG(TAG, "  Receiver hardware: %.*s ", id.size(ID_OXI_HARDWARE), id.str(ID_OXI_HARDWARE));
+  ESP_LOGCONFIG(TAG, "  Receiver firmware: %.*s ", id.size(ID_OXI_FIRMWARE), id.str(ID_OXI_FIRMWARE));
+  ESP_LOGCONFIG(TAG, "  Receiver Description: %.*s ", id.size(ID_OXI_DESCRIPTION), id.str(ID_OXI_DESCRIPTION));
+  ESP_LOGCONFIG(TAG, "  Free heap: %u B, largest free block: %u B", heap_caps_get_free_size(MALLOC_CAP_8BIT),
+                heap_caps_get_largest_free_block(MALLOC_CAP_8BIT));
 
   //settings - level 1
   ESP_LOGCONFIG(TAG, "  Auto close - L1: %S ", autocls_flag ? "Yes" : "No");
@@ -1023,7 +1983,7 @@ std::vector<uint8_t> NiceBusT4::gen_control_cmd(const uint8_t control_cmd) {
   frame.push_back(CONTROL);
   frame.push_back(RUN);
   frame.push_back(control_cmd);
-  frame.push_back(0x64); // OFFSET CMD, DPRO924 refused to work with 0x00, although other drives responded to commands
+  frame.push_back(CMD_OFFSET); // OFFSET CMD
   uint8_t crc2 = (frame[7] ^ frame[8] ^ frame[9] ^ frame[10]);
   frame.push_back(crc2);
   uint8_t f_size = frame.size();
@@ -1072,30 +2032,93 @@ std::vector<uint8_t> NiceBusT4::gen_inf_cmd(const uint8_t to_addr1, const uint8_
 }
 
 
-void NiceBusT4::send_raw_cmd(std::string data) {
-
-  std::vector < uint8_t > v_cmd = raw_cmd_prepare (data);
-  send_array_cmd (&v_cmd[0], v_cmd.size());
+bool NiceBusT4::send_raw_cmd(const std::string &data, uint8_t priority, bool fix_crc) {
+  return this->send_raw_cmd(data, priority, fix_crc, 0, nullptr);
 }
 
-//  Here you need to add a check for incorrect data from the user
-std::vector<uint8_t> NiceBusT4::raw_cmd_prepare(std::string data) { // preparing user-entered data for sending
-  // remove everything except hexadecimal letters and numbers
-  data.erase(remove_if(data.begin(), data.end(), [](const unsigned char ch) {
-    return (!(isxdigit(ch)) );
-  }), data.end()); 
+bool NiceBusT4::send_raw_cmd(const std::string &data, uint8_t priority, bool fix_crc, uint32_t timeout, AwaitCallback &&done) {
+  uint8_t frame[RAW_FRAME_MAX];
+  size_t len = this->parse_hex_(data, frame, sizeof(frame));
+  if (len == 0) {
+    ESP_LOGW(TAG, "Raw command rejected, expected pairs of hex digits: %s", data.c_str());
+    return false;
+  }
+  if (fix_crc) {
+    if (len < 12) {  // 0x55, size, header, CRC1, at least one byte, CRC2, size
+      ESP_LOGW(TAG, "Raw command too short to fix the checksums: %u bytes", (unsigned) len);
+      return false;
+    }
+    this->fix_frame_(frame, len);
+  }
+  bool queued = done ? this->send_awaited(std::vector<uint8_t>(frame, frame + len), priority, timeout, std::move(done))
+                     : this->tx_buffer_.push(std::vector<uint8_t>(frame, frame + len), priority);
+  if (!queued) {
+    ESP_LOGW(TAG, "Raw command dropped, %u low priority frames waiting", TX_LOW_LIMIT);
+    return false;
+  }
+  return true;
+}
 
-  //assert (data.size () % 2 == 0); // check parity
-  std::vector < uint8_t > frame;
-  frame.resize(0); // reset the command size
+bool NiceBusT4::send_frame(const uint8_t *frame, size_t len, uint8_t priority) {
+  if ((len < 12) || (len > RAW_FRAME_MAX) || (frame[0] != START_CODE) || (frame[1] != len - 3) || (frame[len - 1] != len - 3))
+    return false;
+  uint8_t crc1 = frame[2] ^ frame[3] ^ frame[4] ^ frame[5] ^ frame[6] ^ frame[7];
+  uint8_t crc2 = 0;
+  for (size_t i = 9; i < len - 2; i++)
+    crc2 ^= frame[i];
+  if ((frame[8] != crc1) || (frame[len - 2] != crc2))
+    return false;
+  return this->tx_buffer_.push(std::vector<uint8_t>(frame, frame + len), priority);
+}
 
-  for (uint8_t i = 0; i < data.size (); i += 2 ) {          // fill the command array
-    std::string sub_str(data, i, 2);                        // take 2 bytes from the command
-    char hexstoi = (char)std::strtol(&sub_str[0], 0 , 16);  // convert to number
-    frame.push_back(hexstoi);                               // write the number to the line element of the new command
+// a single pass over the text: bytes are two hex digits, separators are allowed only between bytes
+size_t NiceBusT4::parse_hex_(const std::string &text, uint8_t *out, size_t max) {
+  size_t len = 0;
+  bool high = true;  // the next digit is the high nibble
+  for (char ch : text) {
+    uint8_t nibble;
+    if (ch >= '0' && ch <= '9')
+      nibble = ch - '0';
+    else if (ch >= 'a' && ch <= 'f')
+      nibble = ch - 'a' + 10;
+    else if (ch >= 'A' && ch <= 'F')
+      nibble = ch - 'A' + 10;
+    else if (ch == ' ' || ch == '.' || ch == ':' || ch == '-' || ch == ',' || ch == '\t') {
+      if (!high)
+        return 0;  // a lone digit
+      continue;
+    } else
+      return 0;
+    if (high) {
+      if (len == max)
+        return 0;
+      out[len] = nibble << 4;
+    } else {
+      out[len++] |= nibble;
+    }
+    high = !high;
   }
-  
-  return frame;
+  return high ? len : 0;
+}
+
+// frame starting with 0x55: size and mes_size from the length, then both checksums
+void NiceBusT4::fix_frame_(uint8_t *frame, size_t len) {
+  frame[1] = len - 3;
+  frame[len - 1] = len - 3;
+  frame[7] = len - 10;  // bytes after CRC1, CRC2 included
+  frame[8] = frame[2] ^ frame[3] ^ frame[4] ^ frame[5] ^ frame[6] ^ frame[7];
+  uint8_t crc2 = frame[9];
+  for (size_t i = 10; i < len - 2; i++)
+    crc2 ^= frame[i];
+  frame[len - 2] = crc2;
+}
+
+std::vector<uint8_t> NiceBusT4::raw_cmd_prepare(const std::string &data) { // preparing user-entered data for sending
+  uint8_t frame[RAW_FRAME_MAX];
+  size_t len = this->parse_hex_(data, frame, sizeof(frame));
+  if (len == 0)
+    ESP_LOGW(TAG, "Expected pairs of hex digits: %s", data.c_str());
+  return std::vector<uint8_t>(frame, frame + len);
 }
 
 
@@ -1104,6 +2127,7 @@ void NiceBusT4::send_array_cmd(std::vector<uint8_t> data) {          // sends br
 }
 void NiceBusT4::send_array_cmd(const uint8_t *data, size_t len) {
   // sending data to uart
+  uint32_t send_start = micros();
 
   char br_ch = 0x00;                            // for break
   uartFlush(_uart);                             // clear uart
@@ -1122,8 +2146,26 @@ void NiceBusT4::send_array_cmd(const uint8_t *data, size_t len) {
   uart_wait_tx_done(UART_NUM_1,100);    // for ESP32        // waiting for the sending to complete
   delayMicroseconds(90);
   //delayMicroseconds(150); //for ESP32
+  this->metrics_.send_time.add(micros() - send_start);
+  this->arb_.last_byte = micros();
+  this->arb_.backoff = 0;
+  if ((len >= 12) && (data[2] == this->addr_to[0]) && (data[3] == this->addr_to[1]) &&
+      ((data[6] != INF) || (data[11] == GET)))  // only requests the drive has to answer, see watchdog_rx_
+    this->wd_.last_tx = millis();
+  if (len > 3) {  // every frame we send is a request
+    this->arb_.exchange = true;
+    this->arb_.foreign = false;
+    this->arb_.exchange_addr[0] = data[2];
+    this->arb_.exchange_addr[1] = data[3];
+    this->arb_.exchange_start = millis();
+  }
+  this->metrics_.frames_tx++;
+  this->remember_sent_(data, len);
+  this->frame_callback_.call(FRAME_TX, data, len, FRAME_OK);
+  this->track_request_(data, len);
 
-
+  if (this->quiet_)
+    return;
   std::string pretty_cmd = format_hex_pretty((uint8_t*)&data[0], len);                    // to output the command to the log
   ESP_LOGI(TAG,  "Sent: %S ", pretty_cmd.c_str() );
 
@@ -1137,7 +2179,8 @@ void NiceBusT4::send_inf_cmd(std::string to_addr, std::string whose, std::string
   std::vector < uint8_t > v_type_command = raw_cmd_prepare (type_command);
   std::vector < uint8_t > v_next_data = raw_cmd_prepare (next_data);
   std::vector < uint8_t > v_data_command = raw_cmd_prepare (data_command);
-
+  if (v_to_addr.size() < 2 || v_whose.empty() || v_command.empty() || v_type_command.empty() || v_next_data.empty() || (data_on && v_data_command.empty()))
+    return;
 
   if (data_on) {
     tx_buffer_.push(gen_inf_cmd(v_to_addr[0], v_to_addr[1], v_whose[0], v_command[0], v_type_command[0], v_next_data[0], v_data_command, v_data_command.size()));
@@ -1150,6 +2193,8 @@ void NiceBusT4::send_inf_cmd(std::string to_addr, std::string whose, std::string
 void NiceBusT4::set_mcu(std::string command, std::string data_command) {
     std::vector < uint8_t > v_command = raw_cmd_prepare (command);
     std::vector < uint8_t > v_data_command = raw_cmd_prepare (data_command);
+    if (v_command.empty() || v_data_command.empty())
+      return;
     tx_buffer_.push(gen_inf_cmd(0x04, v_command[0], 0xa9, 0x00, v_data_command));
   }
   
@@ -1165,7 +2210,7 @@ void NiceBusT4::init_device(const uint8_t addr1, const uint8_t addr2, const uint
     tx_buffer_.push(gen_inf_cmd(addr1, addr2, device, POS_MAX, GET, 0x00));   //opening position request
     tx_buffer_.push(gen_inf_cmd(addr1, addr2, device, POS_MIN, GET, 0x00)); // closing position request
     tx_buffer_.push(gen_inf_cmd(addr1, addr2, FOR_ALL, DSC, GET, 0x00)); //request description
-    if (is_walky)  // request for maximum value for encoder
+    if (this->drive_->position_format == POSITION_U8)  // request for maximum value for encoder
       tx_buffer_.push(gen_inf_cmd(addr1, addr2, device, MAX_OPN, GET, 0x00, {0x01}, 1));
     else
       tx_buffer_.push(gen_inf_cmd(addr1, addr2, device, MAX_OPN, GET, 0x00));
@@ -1191,6 +2236,7 @@ void NiceBusT4::init_device(const uint8_t addr1, const uint8_t addr2, const uint
 
     //other settings/informations
     tx_buffer_.push(gen_inf_cmd(addr1, addr2, device, P_COUNT, GET, 0x00)); // Number of cycles
+    this->refresh_registers();  // registers of the entities
   }
   if (device == FOR_OXI) {
     tx_buffer_.push(gen_inf_cmd(addr1, addr2, FOR_ALL, PRD, GET, 0x00)); // product request
@@ -1208,20 +2254,26 @@ void NiceBusT4::init_device(const uint8_t addr1, const uint8_t addr2, const uint
 
 // Querying the conditional current position of the actuator
 void NiceBusT4::request_position(void) {
-  if (is_walky)
+  if (this->drive_->position_format == POSITION_U8)
     tx_buffer_.push(gen_inf_cmd(this->addr_to[0], this->addr_to[1], FOR_CU, CUR_POS, GET, 0x00, {0x01}, 1));
   else
     tx_buffer_.push(gen_inf_cmd(FOR_CU, CUR_POS, GET));
 }
 
-// Update current actuator position
+// Update current actuator position, from STA frames and the CUR_POS replies to the polls in loop();
+// both feed the motion trace and the travel model
 void NiceBusT4::update_position(uint16_t newpos) {
   last_position_time = millis();
   _pos_usl = newpos;
+  trace_sample_(-1, newpos);
+  if (!has_encoder_())  // the travel model estimates the position
+    return;
   position = (_pos_usl - _pos_cls) * 1.0f / (_pos_opn - _pos_cls);
   ESP_LOGI(TAG, "Conditional gate position: %d, position at %%: %.3f", newpos, position);
   if (position < CLOSED_POSITION_THRESHOLD) position = COVER_CLOSED;
+  sample_travel_(last_position_time);
   publish_state_if_changed();  // publish the status
+  sequence_loop_();  // a position step continues with this frame
   
   if ((position_hook_type == STOP_UP && _pos_usl >= position_hook_value) || (position_hook_type == STOP_DOWN && _pos_usl <= position_hook_value)) {
     ESP_LOGI(TAG, "The required position has been reached. Stopping the gate");
@@ -1231,14 +2283,823 @@ void NiceBusT4::update_position(uint16_t newpos) {
 }
 
 // Publish gate status when changed
+// In motion the position goes out only after it moved by the deadband and the interval has passed;
+// operation changes and the position at rest are published at once, so the final position is never lost
 void NiceBusT4::publish_state_if_changed(void) {
   if (current_operation == COVER_OPERATION_IDLE) position_hook_type = IGNORE;
-  if (last_published_op != current_operation || last_published_pos != position) {
-    publish_state();
-    last_published_op = current_operation;
-    last_published_pos = position;
+  if (last_published_op == current_operation && last_published_pos == position)
+    return;
+  uint32_t now = millis();
+  if (last_published_op == current_operation && current_operation != COVER_OPERATION_IDLE) {
+    if (fabsf(position - last_published_pos) < position_deadband_ || now - last_published_time_ < position_interval_)
+      return;
+  }
+  publish_state();
+  last_published_op = current_operation;
+  last_published_pos = position;
+  last_published_time_ = now;
+}
+
+// Travel-time model: a maneuver starts and ends with a change of current_operation
+void NiceBusT4::update_travel_() {
+  uint32_t now = millis();
+  if (current_operation != motion_op_) {
+    if (motion_op_ != COVER_OPERATION_IDLE) {
+      if (motion_full_ && (progress_(motion_op_) >= COVER_OPEN))
+        learn_travel_(now - motion_start_);
+      record_cycle_(current_operation, now - motion_start_);
+    }
+    motion_op_ = current_operation;
+    if (motion_op_ == COVER_OPERATION_IDLE) {
+      position_target_ = NAN;
+      return;
+    }
+    motion_start_ = now;
+    motion_from_ = progress_(motion_op_);
+    motion_full_ = motion_from_ <= COVER_CLOSED;
+    sample_time_ = 0;
+    sample_pos_ = motion_from_;
+    peak_speed_ = 0;
+    knee_found_ = false;
+    return;
+  }
+  if ((motion_op_ == COVER_OPERATION_IDLE) || has_encoder_())
+    return;
+  const TravelDirection &dir = travel_.dir[motion_op_ == COVER_OPERATION_CLOSING];
+  if (dir.travel == 0)
+    return;
+  float time = dir.time_at(motion_from_) + (now - motion_start_) * 1.0f / dir.travel;
+  float progress = std::min(dir.pos_at(std::min(time, 1.0f)), 0.99f);  // the end position comes from the drive
+  position = motion_op_ == COVER_OPERATION_CLOSING ? 1 - progress : progress;
+  if (!std::isnan(position_target_) && (position_hook_type != IGNORE) &&
+      ((position_hook_type == STOP_UP) ? position >= position_target_ : position <= position_target_)) {
+    ESP_LOGI(TAG, "The required position has been reached. Stopping the gate");
+    send_cmd(STOP);
+    position_hook_type = IGNORE;
+  }
+}
+
+void NiceBusT4::learn_travel_(uint32_t duration) {
+  if ((duration < TRAVEL_MIN) || (duration > TRAVEL_MAX))
+    return;
+  TravelDirection &dir = travel_.dir[motion_op_ == COVER_OPERATION_CLOSING];
+  float weight = dir.travel == 0 ? 1.0f : TRAVEL_SMOOTHING;
+  dir.travel = dir.travel + (int32_t) ((int32_t) (duration - dir.travel) * weight);
+  if (knee_found_ && (knee_time_ < duration)) {
+    dir.knee_time += (knee_time_ * 1.0f / duration - dir.knee_time) * weight;
+    dir.knee_pos += (knee_pos_ - dir.knee_pos) * weight;
+  }
+  ESP_LOGI(TAG, "Learned %s travel: %u ms, slowdown after %.0f%% of the time at %.0f%% of the travel",
+           motion_op_ == COVER_OPERATION_CLOSING ? "closing" : "opening", dir.travel, dir.knee_time * 100, dir.knee_pos * 100);
+  travel_pref_.save(&travel_);
+}
+
+// peak speed of every maneuver, the slowdown knee only of complete ones
+void NiceBusT4::sample_travel_(uint32_t now) {
+  if (motion_op_ == COVER_OPERATION_IDLE)
+    return;
+  uint32_t time = now - motion_start_;
+  float pos = progress_(motion_op_);
+  if (time > sample_time_) {
+    float speed = (pos - sample_pos_) / (time - sample_time_);
+    if (speed > peak_speed_) {
+      peak_speed_ = speed;
+    } else if (motion_full_ && !knee_found_ && (peak_speed_ > 0) && (speed < peak_speed_ * TRAVEL_SLOWDOWN)) {
+      knee_found_ = true;  // the slowdown started at the previous sample
+      knee_time_ = sample_time_;
+      knee_pos_ = sample_pos_;
+    }
+  }
+  sample_time_ = time;
+  sample_pos_ = pos;
+}
+
+float NiceBusT4::get_eta() const {
+  if (motion_op_ == COVER_OPERATION_IDLE)
+    return 0;
+  const TravelDirection &dir = travel_.dir[motion_op_ == COVER_OPERATION_CLOSING];
+  if (dir.travel == 0)
+    return NAN;
+  float target = 1;
+  if (!std::isnan(position_target_))
+    target = motion_op_ == COVER_OPERATION_CLOSING ? 1 - position_target_ : position_target_;
+  float remaining = dir.time_at(target) - dir.time_at(progress_(motion_op_));
+  return std::max(remaining, 0.0f) * dir.travel / 1000;
+}
+
+void NiceBusT4::record_cycle_(CoverOperation next, uint32_t duration) {
+  uint8_t dir = motion_op_ == COVER_OPERATION_CLOSING;
+  bool complete = motion_full_ && (progress_(motion_op_) >= COVER_OPEN);
+  bool reversal = next != COVER_OPERATION_IDLE;
+  uint16_t day = maint_today_();
+  maint_.today = day;
+  for (uint8_t i = 0; i < 2; i++) {
+    MaintenanceBin &bin = i == 0 ? maint_bin_(maint_.days, MAINT_DAYS, 1, day) : maint_bin_(maint_.weeks, MAINT_WEEKS, 7, day);
+    bin.cycles++;
+    if (reversal)
+      bin.reversals++;
+    else if (!complete)
+      bin.stops++;
+    if (complete) {
+      bin.complete[dir]++;
+      bin.duration[dir] += duration;
+    }
+    if (has_encoder_() && (duration > 0)) {  // 0.1 %/s from the share of the travel per ms
+      bin.peak_speed = std::max(bin.peak_speed, (uint16_t) std::min(peak_speed_ * 1e6f, 65535.0f));
+      bin.speeds++;
+      bin.mean_speed += (uint32_t) std::max((progress_(motion_op_) - motion_from_) * 1e6f / duration, 0.0f);
+    }
+  }
+  maint_dirty_ = true;
+  ESP_LOGD(TAG, "Cycle %s: %u ms, %s", dir ? "closing" : "opening", duration, complete ? "complete" : (reversal ? "reversed" : "stopped"));
+  tx_buffer_.push(gen_inf_cmd(FOR_CU, P_COUNT, GET), TX_LOW);  // the drive counted it too
+}
+
+uint16_t NiceBusT4::maint_today_() {
+#ifdef USE_TIME
+  if (time_ != nullptr) {
+    ESPTime time = time_->now();
+    if (time.is_valid())
+      return time.timestamp / 86400;
+  }
+#endif
+  return maint_.today;  // uptime days, advanced by maint_loop_()
+}
+
+// bin of the day in a ring of periods of the given number of days, emptied when it held an older period
+MaintenanceBin &NiceBusT4::maint_bin_(MaintenanceBin *ring, uint8_t size, uint8_t days, uint16_t day) {
+  MaintenanceBin &bin = ring[(day / days) % size];
+  if ((bin.day == 0) || (bin.day / days != day / days))
+    bin = MaintenanceBin{};
+  bin.day = day;
+  return bin;
+}
+
+void NiceBusT4::maint_loop_() {
+  uint32_t now = millis();
+  if (now - maint_checked_ < 60000)
+    return;
+  maint_checked_ = now;
+  if (now - maint_day_start_ >= MAINT_DAY) {
+    maint_day_start_ += MAINT_DAY;
+    maint_.today++;
+  }
+  maint_.today = maint_today_();
+  if (maint_dirty_ && (now - maint_saved_ >= MAINT_SAVE_INTERVAL)) {
+    maint_pref_.save(&maint_);
+    maint_dirty_ = false;
+    maint_saved_ = now;
+  }
+}
+
+float NiceBusT4::get_cycles_per_day() const {
+  uint16_t first = maint_.today;  // first day with any record
+  for (const auto &bin : maint_.weeks)
+    if (bin.day != 0)
+      first = std::min(first, (uint16_t) (bin.day - bin.day % 7));
+  for (const auto &bin : maint_.days)
+    if (bin.day != 0)
+      first = std::min(first, bin.day);
+  uint16_t span = std::min<uint16_t>(maint_.today - first, MAINT_RECENT_DAYS);  // complete days only
+  if (span == 0)
+    return NAN;
+  uint32_t cycles = 0;
+  for (uint16_t day = maint_.today - span; day < maint_.today; day++) {
+    const MaintenanceBin &bin = maint_.days[day % MAINT_DAYS];
+    if (bin.day == day)
+      cycles += bin.cycles;
+  }
+  return cycles * 1.0f / span;
+}
+
+float NiceBusT4::get_duration_drift() const {
+  uint16_t start = maint_.today > MAINT_RECENT_DAYS ? maint_.today - MAINT_RECENT_DAYS : 0;
+  float drift = 0;
+  uint8_t dirs = 0;
+  for (uint8_t dir = 0; dir < 2; dir++) {
+    uint32_t count = 0;
+    uint32_t duration = 0;
+    for (const auto &bin : maint_.days) {
+      if ((bin.day > start) && (bin.day <= maint_.today)) {
+        count += bin.complete[dir];
+        duration += bin.duration[dir];
+      }
+    }
+    const MaintenanceBin *base = nullptr;  // the oldest week before the recent days
+    for (const auto &bin : maint_.weeks) {
+      if ((bin.day != 0) && (bin.complete[dir] > 0) && (bin.day / 7 < start / 7) && ((base == nullptr) || (bin.day < base->day)))
+        base = &bin;
+    }
+    if ((count == 0) || (base == nullptr))
+      continue;
+    float recent = duration * 1.0f / count;
+    float baseline = base->duration[dir] * 1.0f / base->complete[dir];
+    drift += (recent / baseline - 1) * 100;
+    dirs++;
+  }
+  return dirs > 0 ? drift / dirs : NAN;
+}
+
+float NiceBusT4::get_cycles_until_service() const {
+  if ((service_interval_ == 0) || !p_count_known_)
+    return NAN;
+  return (float) service_interval_ - (float) p_count;  // negative when the service is overdue
+}
+
+void NiceBusT4::cancel_maintenance() {
+  ESP_LOGI(TAG, "Cancel maintenance request");
+  tx_buffer_.push(gen_inf_cmd(FOR_CU, C_MAIN, SET, 0x00, {0x01}), TX_HIGH);
+}
+
+void NiceBusT4::add_sequence(const char *name) {
+  if (this->sequence_count_ == SEQUENCES) {
+    ESP_LOGE(TAG, "Sequence %s: more than %u sequences", name, SEQUENCES);
+    return;
+  }
+  Sequence &seq = this->sequences_[this->sequence_count_++];
+  seq.name = name;
+  seq.count = 0;
+}
+
+void NiceBusT4::add_sequence_step(uint8_t type, uint8_t code, uint8_t len, uint32_t value, uint32_t timeout) {
+  if (this->sequence_count_ == 0)
+    return;
+  Sequence &seq = this->sequences_[this->sequence_count_ - 1];
+  if (seq.count == SEQUENCE_STEPS) {
+    ESP_LOGE(TAG, "Sequence %s: more than %u steps", seq.name, SEQUENCE_STEPS);
+    return;
+  }
+  seq.steps[seq.count++] = SequenceStep{type, code, len, value, timeout};
+}
+
+bool NiceBusT4::run_sequence(const std::string &name) {
+  for (uint8_t i = 0; i < this->sequence_count_; i++) {
+    if (name != this->sequences_[i].name)
+      continue;
+    if (this->seq_ != nullptr) {
+      ESP_LOGW(TAG, "Sequence %s stopped by %s", this->seq_->name, name.c_str());
+      this->sequence_end_(false);
+    }
+    ESP_LOGI(TAG, "Sequence %s started", name.c_str());
+    this->seq_ = &this->sequences_[i];
+    this->seq_step_ = 0;
+    this->seq_run_++;
+    this->sequence_next_();
+    return true;
+  }
+  ESP_LOGW(TAG, "Unknown sequence %s", name.c_str());
+  return false;
+}
+
+void NiceBusT4::stop_sequence() {
+  if (this->seq_ != nullptr)
+    this->sequence_end_(false);
+}
+
+void NiceBusT4::sequence_next_() {
+  while (this->seq_ != nullptr) {
+    if (this->seq_step_ >= this->seq_->count) {
+      this->sequence_end_(true);
+      return;
+    }
+    const SequenceStep &step = this->seq_->steps[this->seq_step_];
+    this->seq_step_start_ = millis();
+    switch (step.type) {
+      case STEP_COMMAND:
+        this->send_cmd(step.code);
+        break;
+      case STEP_WAIT_POSITION:
+        this->seq_rising_ = this->position * 1000 < step.value;
+        if (this->sequence_position_reached_(step))
+          break;
+        return;
+      case STEP_SET_REGISTER: {
+        uint8_t run = this->seq_run_;
+        this->set_register(step.code, step.value, step.len, [this, run](uint8_t result) {
+          if ((run != this->seq_run_) || (this->seq_ == nullptr))
+            return;  // the sequence ended meanwhile
+          if (result != AWAIT_OK) {
+            ESP_LOGW(TAG, "Sequence %s: register write failed", this->seq_->name);
+            this->sequence_end_(false);
+            return;
+          }
+          this->seq_step_++;
+          this->sequence_next_();
+        });
+        return;
+      }
+      default:  // STEP_WAIT_STATUS, STEP_DELAY
+        return;
+    }
+    this->seq_step_++;
   }
 }
 
+bool NiceBusT4::sequence_position_reached_(const SequenceStep &step) const {
+  float pos = this->position * 1000;
+  return this->seq_rising_ ? pos >= step.value : pos <= step.value;
+}
+
+void NiceBusT4::sequence_status_(uint8_t status) {
+  if (this->seq_ == nullptr)
+    return;
+  const SequenceStep &step = this->seq_->steps[this->seq_step_];
+  if ((step.type != STEP_WAIT_STATUS) || (step.code != status))
+    return;
+  this->seq_step_++;
+  this->sequence_next_();
+}
+
+void NiceBusT4::sequence_loop_() {
+  if (this->seq_ == nullptr)
+    return;
+  const SequenceStep &step = this->seq_->steps[this->seq_step_];
+  uint32_t elapsed = millis() - this->seq_step_start_;
+  bool done = false;
+  if (step.type == STEP_DELAY)
+    done = elapsed >= step.value;
+  else if (step.type == STEP_WAIT_POSITION)
+    done = this->sequence_position_reached_(step);
+  if (done) {
+    this->seq_step_++;
+    this->sequence_next_();
+  } else if ((step.type != STEP_DELAY) && (step.timeout > 0) && (elapsed >= step.timeout)) {
+    ESP_LOGW(TAG, "Sequence %s: step %u timed out", this->seq_->name, this->seq_step_ + 1);
+    this->sequence_end_(false);
+  }
+}
+
+void NiceBusT4::sequence_end_(bool ok) {
+  std::string name = this->seq_->name;
+  this->seq_ = nullptr;
+  this->seq_run_++;
+  ESP_LOGI(TAG, "Sequence %s %s", name.c_str(), ok ? "done" : "failed");
+  this->sequence_callback_.call(name, ok);
+}
+
+static uint8_t put_varint(uint8_t *out, uint32_t value) {
+  uint8_t len = 0;
+  while (value >= 0x80) {
+    out[len++] = (value & 0x7F) | 0x80;
+    value >>= 7;
+  }
+  out[len++] = value;
+  return len;
+}
+
+void NiceBusT4::trace_follow_() {
+  MotionTrace &t = this->trace_;
+  if (current_operation == t.op)
+    return;
+  if (t.recording) {  // the final sample carries the operation at the end
+    this->trace_record_(t.last_status, -1);
+    t.recording = false;
+  }
+  t.op = current_operation;
+  if (t.op == COVER_OPERATION_IDLE)
+    return;
+  if (t.count == TRACE_MANEUVERS) {  // make room in the index
+    t.used -= t.length[0];
+    memmove(t.data, t.data + t.length[0], t.used);
+    memmove(t.length, t.length + 1, (TRACE_MANEUVERS - 1) * sizeof(t.length[0]));
+    t.count--;
+  }
+  t.length[t.count++] = 0;
+  t.recording = true;
+  t.last_time = millis();
+  t.last_pos = _pos_usl;
+  uint8_t header[11];
+  uint8_t len = put_varint(header, t.last_time);
+  len += put_varint(header + len, t.last_pos);
+  header[len++] = t.op;
+  this->trace_put_(header, len);
+}
+
+void NiceBusT4::trace_sample_(int16_t status, int32_t pos) {
+  this->trace_follow_();  // the frame may have started the maneuver
+  this->trace_record_(status, pos);
+}
+
+void NiceBusT4::trace_record_(int16_t status, int32_t pos) {
+  MotionTrace &t = this->trace_;
+  if (!t.recording)
+    return;
+  uint8_t flags = 0;
+  if ((status >= 0) && ((status != t.last_status) || (current_operation != t.op)))
+    flags |= TRACE_STATUS;
+  if ((pos >= 0) && (pos != t.last_pos))
+    flags |= TRACE_POSITION;
+  if (flags == 0)
+    return;
+  uint32_t now = millis();
+  uint8_t sample[13];
+  uint8_t len = put_varint(sample, ((now - t.last_time) << 2) | flags);
+  if (flags & TRACE_STATUS) {
+    sample[len++] = status;
+    sample[len++] = current_operation;
+    t.last_status = status;
+  }
+  if (flags & TRACE_POSITION) {
+    int32_t delta = pos - t.last_pos;
+    len += put_varint(sample + len, (uint32_t) ((delta << 1) ^ (delta >> 31)));  // zigzag
+    t.last_pos = pos;
+  }
+  t.last_time = now;
+  this->trace_put_(sample, len);
+}
+
+// drops the oldest maneuvers for room; a maneuver alone in a full buffer is cut short
+bool NiceBusT4::trace_put_(const uint8_t *bytes, uint8_t len) {
+  MotionTrace &t = this->trace_;
+  while (t.used + len > TRACE_BUFFER) {
+    if (t.count <= 1) {
+      t.recording = false;
+      ESP_LOGW(TAG, "Motion trace full, the maneuver is cut short");
+      return false;
+    }
+    t.used -= t.length[0];
+    memmove(t.data, t.data + t.length[0], t.used);
+    memmove(t.length, t.length + 1, (t.count - 1) * sizeof(t.length[0]));
+    t.count--;
+  }
+  memcpy(t.data + t.used, bytes, len);
+  t.used += len;
+  t.length[t.count - 1] += len;
+  return true;
+}
+
+void NiceBusT4::dump_trace() {
+  const MotionTrace &t = this->trace_;
+  std::vector<uint8_t> dump;
+  dump.reserve(t.used + 8 + 3 * t.count);
+  uint8_t buf[5];
+  dump.push_back(TRACE_VERSION);
+  dump.insert(dump.end(), buf, buf + put_varint(buf, millis()));
+  dump.push_back(t.count);
+  uint16_t offset = 0;
+  for (uint8_t i = 0; i < t.count; i++) {
+    dump.insert(dump.end(), buf, buf + put_varint(buf, t.length[i]));
+    dump.insert(dump.end(), t.data + offset, t.data + offset + t.length[i]);
+    offset += t.length[i];
+  }
+  std::string trace = base64_encode(dump.data(), dump.size());
+  ESP_LOGI(TAG, "Motion trace: %u maneuvers, %u bytes", t.count, t.used);
+  ESP_LOGD(TAG, "%s", trace.c_str());
+  this->trace_callback_.call(trace);
+}
+
+// Configuration snapshots.
+// All GETs are queued at once, the arbiter sends each one after the previous reply; a restore then keeps
+// REGISTER_WRITES verified writes in flight, starting the next one from the completion of the previous.
+bool NiceBusT4::snapshot_config() { return this->config_start_(CONFIG_SNAPSHOT); }
+
+bool NiceBusT4::diff_config(const std::string &snapshot) {
+  if ((this->config_.job != CONFIG_NONE) || !this->config_decode_(snapshot))
+    return false;
+  return this->config_start_(CONFIG_DIFF);
+}
+
+bool NiceBusT4::restore_config(const std::string &snapshot) {
+  if ((this->config_.job != CONFIG_NONE) || !this->config_decode_(snapshot))
+    return false;
+  uint32_t product = this->identity_.product_hash;
+  if ((this->config_target_.product_hash != 0) && (product != 0) && (this->config_target_.product_hash != product)) {
+    ESP_LOGW(TAG, "Configuration snapshot of another product, not restored");
+    return false;
+  }
+  return this->config_start_(CONFIG_RESTORE);
+}
+
+bool NiceBusT4::config_start_(uint8_t job) {
+  if (this->config_.job != CONFIG_NONE) {
+    ESP_LOGW(TAG, "Configuration snapshot already in progress");
+    return false;
+  }
+  if (!this->init_ok) {
+    ESP_LOGW(TAG, "Drive not found yet, no configuration snapshot");
+    return false;
+  }
+  this->config_ = ConfigJob{};
+  this->config_.job = job;
+  this->config_drive_ = ConfigImage{};
+  this->config_drive_.product_hash = this->identity_.product_hash;
+  for (uint8_t reg : CONFIG_REGISTERS)
+    this->tx_buffer_.push(gen_inf_cmd(FOR_CU, reg, GET));
+  this->config_.pending = CONFIG_REGISTER_COUNT;
+  this->config_.deadline =
+      millis() + this->tx_buffer_.size() * (this->tx_gap_ / 1000 + ARB_REPLY_WAIT) + CONFIG_READ_TIMEOUT;
+  ESP_LOGI(TAG, "Reading %u configuration registers", CONFIG_REGISTER_COUNT);
+  return true;
+}
+
+bool NiceBusT4::config_decode_(const std::string &snapshot) {
+  std::vector<uint8_t> data = base64_decode(snapshot);
+  if ((data.size() < 6) || (data[0] != CONFIG_VERSION)) {
+    ESP_LOGW(TAG, "Not a configuration snapshot of version %u", CONFIG_VERSION);
+    return false;
+  }
+  ConfigImage &image = this->config_target_;
+  image = ConfigImage{};
+  image.product_hash = encode_uint32(data[1], data[2], data[3], data[4]);
+  size_t pos = 6;
+  for (uint8_t n = 0; n < data[5]; n++) {
+    if ((pos + 2 > data.size()) || (data[pos + 1] < 1) || (data[pos + 1] > 4) || (pos + 2 + data[pos + 1] > data.size())) {
+      ESP_LOGW(TAG, "Configuration snapshot truncated");
+      return false;
+    }
+    uint8_t reg = data[pos];
+    uint8_t len = data[pos + 1];
+    const uint8_t *i = std::find(CONFIG_REGISTERS, CONFIG_REGISTERS + CONFIG_REGISTER_COUNT, reg);
+    if (i != CONFIG_REGISTERS + CONFIG_REGISTER_COUNT) {
+      image.len[i - CONFIG_REGISTERS] = len;
+      image.value[i - CONFIG_REGISTERS] = register_value(&data[pos + 2], len);
+    } else {
+      ESP_LOGW(TAG, "Register %02X of the snapshot is not a configuration register, ignored", reg);
+    }
+    pos += 2 + len;
+  }
+  return true;
+}
+
+std::string NiceBusT4::config_encode_(const ConfigImage &image) const {
+  uint8_t data[6 + CONFIG_REGISTER_COUNT * 6];
+  size_t pos = 6;
+  uint8_t count = 0;
+  for (uint8_t i = 0; i < CONFIG_REGISTER_COUNT; i++) {
+    uint8_t len = image.len[i];
+    if ((len == 0) || (len == CONFIG_REFUSED))
+      continue;
+    data[pos++] = CONFIG_REGISTERS[i];
+    data[pos++] = len;
+    for (uint8_t b = 0; b < len; b++)
+      data[pos++] = image.value[i] >> (8 * (len - 1 - b));
+    count++;
+  }
+  data[0] = CONFIG_VERSION;
+  data[1] = image.product_hash >> 24;
+  data[2] = image.product_hash >> 16;
+  data[3] = image.product_hash >> 8;
+  data[4] = image.product_hash;
+  data[5] = count;
+  return base64_encode(data, pos);
+}
+
+void NiceBusT4::config_reply_(const std::vector<uint8_t> &data) {
+  if ((this->config_.job == CONFIG_NONE) || this->config_.writing || (data.size() < 16) || (data[6] != INF) ||
+      (data[9] != FOR_CU) || (data[11] != GET - 0x80) || (data[4] != this->addr_to[0]) || (data[5] != this->addr_to[1]))
+    return;
+  const uint8_t *reg = std::find(CONFIG_REGISTERS, CONFIG_REGISTERS + CONFIG_REGISTER_COUNT, data[10]);
+  if (reg == CONFIG_REGISTERS + CONFIG_REGISTER_COUNT)
+    return;
+  uint8_t i = reg - CONFIG_REGISTERS;
+  if (this->config_drive_.len[i] != 0)
+    return;  // answered already
+  uint8_t len = std::min<size_t>(data.size() - 16, 4);
+  if ((data[13] != NOERR) || (len == 0)) {
+    this->config_drive_.len[i] = CONFIG_REFUSED;
+  } else {
+    this->config_drive_.len[i] = len;
+    this->config_drive_.value[i] = register_value(&data[14], len);
+  }
+  if (--this->config_.pending == 0)
+    this->config_read_done_();
+}
+
+void NiceBusT4::config_loop_() {
+  if ((this->config_.job == CONFIG_RESTORE) && this->config_.writing) {
+    this->config_write_next_();  // registers left waiting for a free write slot
+    return;
+  }
+  if ((this->config_.job != CONFIG_NONE) && !this->config_.writing &&
+      ((int32_t) (millis() - this->config_.deadline) >= 0)) {
+    ESP_LOGW(TAG, "%u configuration registers not answered", this->config_.pending);
+    this->config_read_done_();
+  }
+}
+
+void NiceBusT4::config_read_done_() {
+  const ConfigImage &drive = this->config_drive_;
+  const ConfigImage &target = this->config_target_;
+  uint8_t read = 0, refused = 0;
+  for (uint8_t len : drive.len) {
+    if (len == CONFIG_REFUSED)
+      refused++;
+    else if (len != 0)
+      read++;
+  }
+  char buf[96];
+  if (this->config_.job == CONFIG_RESTORE) {
+    this->config_.writing = true;
+    this->config_write_next_();
+    return;
+  }
+  std::string report;
+  if (this->config_.job == CONFIG_SNAPSHOT) {
+    snprintf(buf, sizeof(buf), "{\"job\":\"snapshot\",\"registers\":%u,\"refused\":%u,\"missing\":%u}", read,
+             refused, this->config_.pending);
+    this->config_finish_(buf);
+    return;
+  }
+  // diff: registers of the snapshot that the drive reports with another value, or not at all
+  snprintf(buf, sizeof(buf), "{\"job\":\"diff\",\"product_match\":%s,\"differ\":[",
+           (target.product_hash == drive.product_hash) ? "true" : "false");
+  report = buf;
+  uint8_t differ = 0;
+  for (uint8_t i = 0; i < CONFIG_REGISTER_COUNT; i++) {
+    if ((target.len[i] == 0) || ((drive.len[i] == target.len[i]) && (drive.value[i] == target.value[i])))
+      continue;
+    if ((drive.len[i] == 0) || (drive.len[i] == CONFIG_REFUSED))
+      snprintf(buf, sizeof(buf), "%s{\"register\":%u,\"snapshot\":%u}", differ ? "," : "", CONFIG_REGISTERS[i],
+               target.value[i]);
+    else
+      snprintf(buf, sizeof(buf), "%s{\"register\":%u,\"drive\":%u,\"snapshot\":%u}", differ ? "," : "",
+               CONFIG_REGISTERS[i], drive.value[i], target.value[i]);
+    report += buf;
+    differ++;
+  }
+  snprintf(buf, sizeof(buf), "],\"registers\":%u,\"missing\":%u}", read, this->config_.pending);
+  report += buf;
+  this->config_finish_(report);
+}
+
+void NiceBusT4::config_write_next_() {
+  ConfigJob &job = this->config_;
+  while ((job.job == CONFIG_RESTORE) && (job.writes < REGISTER_WRITES) && (job.next < CONFIG_REGISTER_COUNT)) {
+    uint8_t i = job.next;
+    uint8_t len = this->config_target_.len[i];
+    uint32_t value = this->config_target_.value[i];
+    if (len == 0) {
+      job.next++;  // not in the snapshot
+      continue;
+    }
+    if ((this->config_drive_.len[i] == 0) || (this->config_drive_.len[i] == CONFIG_REFUSED)) {
+      job.next++;
+      job.failed++;  // the drive did not answer or does not have it
+      continue;
+    }
+    if (this->config_drive_.value[i] == value) {
+      job.next++;
+      job.unchanged++;
+      continue;
+    }
+    if (!this->register_write_free_(CONFIG_REGISTERS[i]))
+      return;  // the slots are taken by entity writes, config_loop_() tries again
+    job.next++;
+    job.writes++;
+    this->set_register(CONFIG_REGISTERS[i], value, len, [this, i, len, value](uint8_t result) {
+      if (this->config_.job != CONFIG_RESTORE)
+        return;
+      this->config_.writes--;
+      if (result == AWAIT_OK) {
+        this->config_.written++;
+        this->config_drive_.len[i] = len;
+        this->config_drive_.value[i] = value;
+      } else {
+        this->config_.failed++;
+      }
+      this->config_write_next_();
+    });
+  }
+  if ((job.job == CONFIG_RESTORE) && (job.writes == 0) && (job.next == CONFIG_REGISTER_COUNT)) {
+    char buf[96];
+    snprintf(buf, sizeof(buf), "{\"job\":\"restore\",\"written\":%u,\"failed\":%u,\"unchanged\":%u}", job.written,
+             job.failed, job.unchanged);
+    this->config_finish_(buf);
+  }
+}
+
+void NiceBusT4::config_finish_(const std::string &report) {
+  this->config_.job = CONFIG_NONE;
+  std::string snapshot = this->config_encode_(this->config_drive_);
+  ESP_LOGI(TAG, "Configuration: %s", report.c_str());
+  ESP_LOGD(TAG, "%s", snapshot.c_str());
+  this->config_callback_.call(report, snapshot);
+}
+
+
+// Bus census.
+// printable part of an identity string, safe to put in the log and in JSON
+static uint8_t census_name(char *out, const uint8_t *data, size_t len) {
+  uint8_t n = 0;
+  while ((n < len) && (n < CENSUS_NAME) && (data[n] != 0)) {
+    char ch = data[n];
+    out[n++] = ((ch < 0x20) || (ch > 0x7E) || (ch == '"') || (ch == '\\')) ? '?' : ch;
+  }
+  return n;
+}
+
+void NiceBusT4::census_frame_(const std::vector<uint8_t> &data) {
+  if ((data.size() < 14) || ((data[4] == 0) && (data[5] == 0)))
+    return;
+  if ((data[4] == this->addr_from[0]) && (data[5] == this->addr_from[1]))
+    return;  // another gateway using our address, not a device
+  uint32_t now = millis();
+  CensusDevice *device = nullptr;
+  CensusDevice *slot = nullptr;  // a free slot, otherwise the device heard longest ago
+  for (auto &d : this->census_) {
+    if ((d.addr[0] == data[4]) && (d.addr[1] == data[5])) {
+      device = &d;
+      break;
+    }
+    if ((slot == nullptr) || (slot->used() && (!d.used() || (int32_t) (d.last_seen - slot->last_seen) < 0)))
+      slot = &d;
+  }
+  if (device == nullptr) {
+    device = slot;
+    if (device->used())
+      ESP_LOGD(TAG, "Census full, 0x%02X%02X replaced", device->addr[0], device->addr[1]);
+    *device = CensusDevice{};
+    device->addr[0] = data[4];
+    device->addr[1] = data[5];
+    ESP_LOGI(TAG, "New device on the bus: 0x%02X%02X", data[4], data[5]);
+  }
+  device->frames++;
+  device->window_frames++;
+  device->last_seen = now;
+
+  // FOR_ALL replies tell what the device is
+  if ((data.size() < 16) || (data[6] != INF) || (data[9] != FOR_ALL) || (data[11] != GET - 0x80) || (data[13] != NOERR))
+    return;
+  switch (data[10]) {
+    case WHO:
+      if (data.size() > 16)
+        device->device_class = data[14];
+      break;
+    case PRD:
+      device->product_len = census_name(device->product, &data[14], data.size() - 16);
+      device->asked = true;  // asked by somebody else already
+      break;
+    case FRM:
+      device->firmware_len = census_name(device->firmware, &data[14], data.size() - 16);
+      break;
+  }
+}
+
+// WHO rounds and identity requests, paced and only into an empty queue. A round asks the known devices one by one,
+// a broadcast would make them all answer within one frame time; new devices are found by their frames
+void NiceBusT4::census_loop_() {
+  uint32_t now = millis();
+  if (now - this->census_window_ >= CENSUS_WINDOW) {
+    uint32_t window = now - this->census_window_;
+    this->census_window_ = now;
+    this->metrics_.bus_devices = 0;
+    for (auto &d : this->census_) {
+      if (!(d.addr[0] | d.addr[1]))
+        continue;
+      d.rate = d.window_frames * 1000.0f / window;
+      d.window_frames = 0;
+      if (now - d.last_seen < CENSUS_ONLINE)
+        this->metrics_.bus_devices++;
+    }
+  }
+  if (!this->init_ok || !this->tx_buffer_.empty() || this->arb_.exchange || this->bench_.active ||
+      (now - this->census_request_ < CENSUS_PACE))
+    return;
+  if (now - this->census_scan_ >= CENSUS_SCAN) {
+    this->census_scan_ = now;
+    this->census_round_ = 0;
+  }
+  while (this->census_round_ < CENSUS_DEVICES) {
+    const CensusDevice &d = this->census_[this->census_round_++];
+    if (!d.used())
+      continue;
+    this->census_request_ = now;
+    this->tx_buffer_.push(gen_inf_cmd(d.addr[0], d.addr[1], FOR_ALL, WHO, GET, 0x00), TX_LOW);
+    return;
+  }
+  for (auto &d : this->census_) {
+    if (!d.used() || d.asked)
+      continue;
+    d.asked = true;
+    this->census_request_ = now;
+    this->tx_buffer_.push(gen_inf_cmd(d.addr[0], d.addr[1], FOR_ALL, PRD, GET, 0x00), TX_LOW);
+    this->tx_buffer_.push(gen_inf_cmd(d.addr[0], d.addr[1], FOR_ALL, FRM, GET, 0x00), TX_LOW);
+    return;
+  }
+}
+
+void NiceBusT4::dump_census() {
+  uint32_t now = millis();
+  std::string report = "[";
+  char buf[160];
+  ESP_LOGI(TAG, "Bus census:");
+  for (const auto &d : this->census_) {
+    if (!d.used())
+      continue;
+    ESP_LOGI(TAG, "  0x%02X%02X class %02X %-15.*s %-15.*s %7u frames %5.1f/s seen %u s ago", d.addr[0], d.addr[1],
+             d.device_class, d.product_len, d.product, d.firmware_len, d.firmware, d.frames, d.rate,
+             (now - d.last_seen) / 1000);
+    snprintf(buf, sizeof(buf),
+             "%s{\"address\":%u,\"class\":%u,\"product\":\"%.*s\",\"firmware\":\"%.*s\",\"frames\":%u,\"rate\":%.1f,"
+             "\"last_seen\":%u}",
+             report.size() > 1 ? "," : "", (d.addr[0] << 8) | d.addr[1], d.device_class, d.product_len, d.product,
+             d.firmware_len, d.firmware, d.frames, d.rate, (now - d.last_seen) / 1000);
+    report += buf;
+  }
+  report += "]";
+  this->census_callback_.call(report);
+}
+
+
 }  // namespace bus_t4
 }  // namespace esphome
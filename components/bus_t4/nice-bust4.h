@@ -54,8 +54,13 @@ is an intelligent engine, this value is 1 (adr = 1).
 #include "esphome/components/cover/cover.h"
 #include <HardwareSerial.h>
 #include "esphome/core/helpers.h"              // parse strings with built-in tools
+#include "esphome/core/preferences.h"          // learned travel times survive a reboot
 #include <queue>                               // for working with a queue
+#include <cmath>
 #include "driver/uart.h"
+#ifdef USE_TIME
+#include "esphome/components/time/real_time_clock.h"  // days of the maintenance bins
+#endif
 // #include <string>
 // #include "esphome/components/text_sensor/text_sensor.h"
 // #include "esphome/components/text_sensor/template_text_sensor.h"
@@ -244,6 +249,24 @@ enum setup_submnu : uint8_t {
   RUN            = 0x82, // Command to execute
 };
 
+
+/* registers polled by the diagnostics engine, payloads are kept raw */
+static const uint8_t DIAG_REGISTERS[] = {INF_IO, DIAG_BB, DIAG_PAR};
+static const uint8_t DIAG_COUNT = sizeof(DIAG_REGISTERS);
+static const uint8_t DIAG_PAYLOAD_MAX = 16;   // bytes of each payload that are kept and compared
+static const uint32_t DIAG_POLL_BUS_TIME = 25; // ms of bus time for one GET and its EVT reply, breaks included
+
+/* Idle watch: while the gate is idle the drive is asked for INF_STATUS, IDLE_WATCH_MIN after a change and twice
+   as late after each probe, up to idle_watch_interval. The budget only stretches the steady interval, so the first
+   probes after a change stay fast. Movements started by remotes or wired inputs are seen on drives without STA */
+static const uint32_t IDLE_WATCH_MIN = 250;   // ms
+
+/* last payload of a diagnostics register */
+struct DiagPayload {
+  bool valid;
+  uint8_t len;
+  uint8_t data[DIAG_PAYLOAD_MAX];
+};
   
 /* run cmd byte 11 of EVT packets */
 enum run_cmd : uint8_t {
@@ -358,6 +381,561 @@ struct packet_rsp_body_t {
 };
 */
 
+/* Remote control button press, decoded from an OXI button-read packet
+   (whose 0x0A, submenu 0x26, run 0x41) */
+struct RemoteEvent {
+  uint32_t serial;      // remote control serial number, 28 bits
+  uint8_t button;       // pressed button, 1..15
+  uint8_t receiver[2];  // address of the OXI receiver that reported the press
+  uint32_t time;        // millis() when the packet was decoded
+};
+
+/* Bus metrics. Everything is preallocated, a sample only increments counters */
+static const uint8_t HIST_BUCKETS = 8;        // log2 histogram buckets
+static const uint8_t METRIC_DEVICES = 4;      // devices with their own latency histograms
+static const uint8_t PENDING_REQUESTS = 4;    // requests waiting for a reply
+static const uint32_t REPLY_TIMEOUT = 1000;   // ms, a request without a reply after that is counted as lost
+
+/* histogram with bucket i counting values below (base << i), the last bucket counts the rest */
+struct Histogram {
+  uint32_t base;
+  uint32_t count;
+  uint32_t sum;
+  uint32_t max;
+  uint32_t buckets[HIST_BUCKETS];
+
+  void add(uint32_t value) {
+    uint8_t i = 0;
+    while ((i < HIST_BUCKETS - 1) && (value >= (this->base << i)))
+      i++;
+    this->buckets[i]++;
+    this->count++;
+    this->sum += value;
+    if (value > this->max)
+      this->max = value;
+  }
+};
+
+/* reply latencies of one device */
+struct DeviceLatency {
+  uint8_t addr[2];
+  Histogram rsp;  // CMD -> RSP, ms
+  Histogram evt;  // INF GET -> EVT, ms
+};
+
+struct BusMetrics {
+  uint32_t frames_tx;
+  uint32_t frames_rx;
+  uint32_t crc1_errors;
+  uint32_t crc2_errors;
+  uint32_t size_errors;
+  uint32_t lost_replies;        // requests that got no reply within REPLY_TIMEOUT
+  uint32_t other_requests;      // requests of other masters (Oview, OXI) heard on the bus
+  uint32_t echoes;              // our own frames read back from the line and dropped
+  uint32_t missing_echoes;      // frames sent without an echo, only counted once echoes were seen
+  uint32_t recoveries;          // bus faults the watchdog recovered from
+  uint32_t recovery_time;       // ms from the detection of the last fault to the first frame of the drive
+  uint32_t bus_devices;         // devices heard within CENSUS_ONLINE
+  uint16_t tx_queue_depth;
+  uint16_t tx_queue_high_water;
+  Histogram loop_time;          // us spent in loop()
+  Histogram send_time;          // us spent in send_array_cmd
+  DeviceLatency devices[METRIC_DEVICES];
+};
+
+/* Bus census: every device heard on the bus, found by WHO replies and by the source address of every valid frame.
+   Each new device is asked once for its product and firmware, and every CENSUS_SCAN each known device is asked WHO
+   in turn; all of them go out at low priority, one every CENSUS_PACE and only into an empty queue */
+static const uint8_t CENSUS_DEVICES = 16;
+static const uint8_t CENSUS_NAME = 15;            // bytes kept of product and firmware strings
+static const uint32_t CENSUS_SCAN = 60000;        // ms between the starts of WHO rounds
+static const uint32_t CENSUS_PACE = 1000;         // ms between census requests
+static const uint32_t CENSUS_WINDOW = 10000;      // ms over which frame rates are counted
+static const uint32_t CENSUS_ONLINE = 60000;      // ms since the last frame for a device to count as present
+
+/* WHO replies choose the drive and the receiver only this long after the discovery WHO, later ones are census */
+static const uint32_t DISCOVERY_WINDOW = 2000;    // ms
+
+struct CensusDevice {
+  uint8_t addr[2];          // 0x0000 - free slot
+  uint8_t device_class;     // of the WHO reply: 0x04 drive, 0x0A receiver...; 0 - not answered WHO yet
+  bool asked;               // PRD and FRM requested
+  uint8_t product_len;
+  uint8_t firmware_len;
+  char product[CENSUS_NAME];
+  char firmware[CENSUS_NAME];
+  uint32_t frames;          // since boot
+  uint16_t window_frames;   // in the current window
+  float rate;               // frames/s over the last complete window
+  uint32_t last_seen;       // millis()
+  bool used() const { return this->addr[0] | this->addr[1]; }
+};
+
+/* request sent to a device and not yet answered */
+struct PendingRequest {
+  bool active;
+  uint8_t addr[2];
+  uint8_t mes_type;  // CMD or INF
+  uint8_t submenu;   // INF submenu
+  uint32_t time;     // millis() when sent
+};
+
+/* Bus arbitration: we transmit once the line has been quiet for tx_gap, measured with micros() from the last byte.
+   Every request, ours or another master's, holds the bus until its reply comes from the addressed device or
+   ARB_REPLY_WAIT passes; after a request of another master we also back off by a random number of characters */
+static const uint32_t CHAR_TIME = 10000000 / BAUD_WORK;  // us of one 8N1 character, 520 at 19200
+static const uint32_t ARB_REPLY_WAIT = 50;               // ms a reply may take, broadcasts always wait that long
+static const uint8_t ARB_BACKOFF_CHARS = 16;             // longest random backoff
+
+struct BusArbiter {
+  uint32_t last_byte;        // micros() of the last byte on the line, our own frames included
+  uint32_t backoff;          // us added to the gap, random after another master was heard
+  bool exchange;             // a request waits for its reply
+  bool foreign;              // the request was sent by another master
+  uint8_t exchange_addr[2];  // the device that will answer
+  uint32_t exchange_start;   // millis()
+};
+
+/* frames handed to the frame callbacks (bus monitor) */
+enum frame_direction : uint8_t {
+  FRAME_RX = 0,
+  FRAME_TX = 1,
+};
+
+enum frame_status : uint8_t {
+  FRAME_OK   = 0,
+  FRAME_CRC1 = 1,   // rejected, the frame is cut after the CRC1 byte
+  FRAME_CRC2 = 2,
+  FRAME_SIZE = 3,   // size byte at the end does not match
+};
+
+/* Bus watchdog: the drive is considered lost when it does not answer our requests, goes silent while the gate
+   moves, or the TX queue stays long. Every WD_STEP_TIME without a frame of the drive escalates the recovery:
+   1 - re-sync of the frame assembler, 2 - UART driver restart, 3 - new discovery of the drive */
+static const uint32_t WD_REPLY_SILENCE = 5000;   // ms without a frame of the drive after our requests
+static const uint32_t WD_MOVING_SILENCE = 3000;  // ms without a frame of the drive while the gate moves
+static const uint16_t WD_QUEUE_LIMIT = 32;       // frames waiting
+static const uint32_t WD_QUEUE_TIME = 10000;     // ms over the limit
+static const uint32_t WD_STEP_TIME = 3000;       // ms between escalation steps
+static const uint8_t WD_LEVELS = 3;
+
+struct BusWatchdog {
+  uint8_t level;          // recovery steps taken, 0 - healthy
+  uint32_t since;         // millis() when the fault was detected
+  uint32_t last_step;     // millis() of the last recovery step
+  uint32_t last_rx;       // millis() of the last frame of the drive
+  uint32_t last_tx;       // millis() of our last request to the drive
+  uint32_t queue_since;   // millis() when the queue went over the limit, 0 - under
+};
+
+/* Echo suppression: with transceivers on a shared line we read back every frame we send. Received frames equal
+   to a recently sent one are dropped before they are decoded; the echo also confirms the frame reached the line */
+static const uint8_t ECHO_FRAMES = 4;          // sent frames remembered
+static const uint32_t ECHO_TIMEOUT = 100;      // ms for the echo to arrive
+static const uint8_t ECHO_MISSING_WARN = 3;    // missing echoes in a row before we warn about the transmitter
+
+struct SentFrame {
+  bool active;      // echo not seen yet
+  uint8_t len;
+  uint32_t hash;    // FNV-1a of the frame as sent
+  uint32_t time;    // millis()
+};
+
+/* Identity strings of the drive and the receiver, kept in one fixed arena: each field is a length byte followed
+   by up to IDENTITY_FIELD bytes, longer replies are truncated. Drive models are told apart by the FNV-1a hash
+   of the product string, the known ones are hashed at compile time */
+static const uint8_t IDENTITY_FIELD = 31;
+
+enum identity_field : uint8_t {
+  ID_MANUFACTURER     = 0,
+  ID_PRODUCT          = 1,
+  ID_HARDWARE         = 2,
+  ID_FIRMWARE         = 3,
+  ID_DESCRIPTION      = 4,
+  ID_OXI_PRODUCT      = 5,
+  ID_OXI_HARDWARE     = 6,
+  ID_OXI_FIRMWARE     = 7,
+  ID_OXI_DESCRIPTION  = 8,
+};
+static const uint8_t ID_FIELDS = 9;
+
+constexpr uint32_t identity_hash(const char *data, size_t len, uint32_t hash = 2166136261UL) {
+  return len == 0 ? hash : identity_hash(data + 1, len - 1, (uint32_t) ((hash ^ (uint8_t) *data) * 16777619UL));
+}
+
+static const uint32_t PRODUCT_WALKY = identity_hash("WLA1\x00\x06W", 7);
+static const uint32_t PRODUCT_ROBUSHSR10 = identity_hash("ROBUSHSR10\x00", 11);
+
+struct DeviceIdentity {
+  uint8_t fields[ID_FIELDS][1 + IDENTITY_FIELD]{};
+  uint32_t product_hash{0};  // of the drive product, 0 - not read yet
+
+  void set(uint8_t field, const uint8_t *data, size_t len) {
+    if (len > IDENTITY_FIELD)
+      len = IDENTITY_FIELD;
+    this->fields[field][0] = len;
+    memcpy(&this->fields[field][1], data, len);
+    if (field == ID_PRODUCT)
+      this->product_hash = identity_hash((const char *) data, len);
+  }
+  bool known(uint8_t field) const { return this->fields[field][0] > 0; }
+  // for "%.*s"
+  int size(uint8_t field) const { return this->fields[field][0]; }
+  const char *str(uint8_t field) const { return (const char *) &this->fields[field][1]; }
+};
+
+/* Drive profiles: the quirks of a drive family in one table entry, found from the PRD reply or chosen with drive:
+   in YAML. A build for one chosen family leaves the other entries out (USE_BUS_T4_DRIVE holds its number) */
+enum drive_family : uint8_t {
+  DRIVE_GENERIC = 0,  // what works across the tested drives, used until the product is known
+  DRIVE_WALKY   = 1,  // Walky WLA1
+  DRIVE_ROBUS   = 2,  // Robus HSR10
+  DRIVE_ROAD    = 3,  // Road 400
+};
+
+/* byte after the command of CONTROL RUN frames: DPRO924 refuses 0x00, the other tested drives take both */
+static const uint8_t CMD_OFFSET = 0x64;
+
+enum position_format : uint8_t {
+  POSITION_U16 = 0,  // big-endian in payload bytes 0-1
+  POSITION_U8  = 1,  // payload byte 1, CUR_POS and MAX_OPN are requested with {0x01}
+};
+
+struct DriveProfile {
+  uint8_t family;
+  const char *name;
+  uint32_t product_hash;    // of the PRD reply, 0 - only chosen in YAML
+  uint8_t position_format;
+  bool poll_position;       // CUR_POS is polled in motion and positions are taken as encoder feedback
+  uint8_t sta_opening;      // STA codes of the family for a moving gate, 0 - none
+  uint8_t sta_closing;
+
+  // STA code of the family to the common one
+  uint8_t sta(uint8_t code) const {
+    if ((this->sta_opening != 0) && (code == this->sta_opening))
+      return STA_OPENING;
+    if ((this->sta_closing != 0) && (code == this->sta_closing))
+      return STA_CLOSING;
+    return code;
+  }
+};
+
+/* On-device bus benchmark: a sweep of inter-frame gaps in ping-pong mode, then a sweep of request rates */
+static const uint8_t BENCH_GAPS[] = {100, 50, 20, 10, 5, 2};        // ms of silence between a reply and the next GET
+static const uint8_t BENCH_RATES[] = {5, 10, 15, 20, 30, 40, 50};   // GET requests per second
+static const uint8_t BENCH_GAP_STAGES = sizeof(BENCH_GAPS);
+static const uint8_t BENCH_RATE_STAGES = sizeof(BENCH_RATES);
+static const uint8_t BENCH_SAMPLES = 64;      // round-trip times kept per stage for percentiles
+static const uint8_t BENCH_INFLIGHT = 8;      // GETs in flight at the highest rate
+static const uint32_t BENCH_TIMEOUT = 300;    // ms, a GET without EVT after that is lost
+static const uint32_t BENCH_LINE_SILENCE = 2 * CHAR_TIME;  // us, no frame in progress; the sweeps set their own gaps
+// the rate sweep reads a different register in every slot, so each EVT names its GET; the chosen one comes first
+static const uint8_t BENCH_REGISTERS[] = {INF_STATUS, AUTOCLS, PH_CLS_ON, ALW_CLS_ON, STANDBY_ON,
+                                          START_ON, BLINK_ON, SLAVE_ON, TYPE_M};
+
+struct BenchStage {
+  uint8_t param;       // gap in ms or rate in requests/s
+  uint16_t sent;
+  uint16_t received;
+  uint16_t errors;     // CRC and size failures during the stage
+  uint16_t rtt_p50;    // ms
+  uint16_t rtt_p95;
+  uint16_t rtt_max;
+  bool passed() const { return (this->sent > 0) && (this->received == this->sent) && (this->errors == 0); }
+};
+
+struct Benchmark {
+  bool active;
+  bool apply;           // use the shortest tolerated gap for normal traffic when done
+  uint8_t reg;          // register read by the GETs
+  uint16_t count;       // GETs per stage
+  bool rate_phase;      // false - gap sweep, true - rate sweep
+  uint8_t stage;
+  uint8_t gap_stages;   // stages done in each phase
+  uint8_t rate_stages;
+  uint16_t sent;
+  uint16_t received;
+  uint16_t samples;
+  uint32_t errors_start;
+  uint32_t next_send;
+  uint32_t last_rx;
+  uint8_t regs[BENCH_INFLIGHT];        // register of each slot, all different; the gap sweep only uses slot 0
+  uint8_t next_slot;
+  uint8_t inflight;                    // slots waiting for their EVT
+  bool pending[BENCH_INFLIGHT];
+  uint32_t sent_at[BENCH_INFLIGHT];    // millis()
+  uint16_t rtt[BENCH_SAMPLES];
+  BenchStage gaps[BENCH_GAP_STAGES];
+  BenchStage rates[BENCH_RATE_STAGES];
+};
+
+/* Register writes: SET followed by a verifying GET, done when the drive reports the written value */
+static const uint8_t REGISTER_WRITES = 4;             // writes in progress at once
+static const uint8_t REGISTER_WRITE_RETRIES = 2;      // SET + GET repeated after a timeout or a different value
+static const uint32_t REGISTER_WRITE_TIMEOUT = 1000;  // ms after the frames leave the queue
+
+/* Requests awaited by actions: done with the answer of the addressed device - RSP of the same submenu for CMD,
+   the same submenu and run code for INF - or when the timeout passes. Broadcasts take the first answer */
+static const uint8_t AWAITED_REQUESTS = 8;
+
+enum await_result : uint8_t {
+  AWAIT_OK      = 0,
+  AWAIT_ERROR   = 1,  // answered with an error, refused, or read back another value
+  AWAIT_TIMEOUT = 2,  // no answer
+};
+
+// the answer stays valid only during the call, nullptr when there is none
+using AwaitCallback = std::function<void(uint8_t result, const std::vector<uint8_t> *reply)>;
+
+struct AwaitedRequest {
+  bool active;
+  uint8_t addr[2];
+  uint8_t mes_type;     // CMD or INF
+  uint8_t submenu;
+  uint8_t run;          // GET or SET of INF requests, the command of CMD requests
+  uint32_t deadline;    // millis()
+  AwaitCallback done;
+};
+
+struct RegisterWrite {
+  bool active;
+  uint8_t reg;
+  uint8_t len;          // value bytes, big-endian
+  uint8_t retries;
+  uint8_t pending;      // verifying GETs queued and not answered yet
+  uint8_t stale;        // replies still due to the write this one replaced, they are ignored
+  uint32_t value;
+  uint32_t deadline;    // millis()
+  std::function<void(uint8_t)> done;  // await_result
+};
+
+/* registers bound to switch, number, select, sensor and text_sensor entities */
+static const uint8_t WATCHED_REGISTERS = 32;
+
+/* Observer of decoded frames, called right after a frame is decoded, in the loop() that received it.
+   Listeners are kept in a fixed array, subscribing and notifying allocate nothing */
+static const uint8_t MAX_LISTENERS = 32;
+
+class BusT4Listener {
+ public:
+  // GET reply of the drive without error, the payload stays valid only during the call
+  virtual void on_register(uint16_t address, uint8_t reg, const uint8_t *data, uint8_t len) {}
+  // gate status reported by a drive: OPENED, CLOSED, STA_OPENING, STOPPED...
+  virtual void on_status(uint16_t address, uint8_t status) {}
+  virtual void on_remote(const RemoteEvent &event) {}
+  // INF reply with an error byte, e.g. 0xFD - no such command for this device
+  virtual void on_error(uint16_t address, uint8_t reg, uint8_t error) {}
+};
+
+/* big-endian value of the first len payload bytes */
+inline uint32_t register_value(const uint8_t *data, uint8_t len) {
+  uint32_t value = 0;
+  for (uint8_t i = 0; i < len; i++)
+    value = (value << 8) | data[i];
+  return value;
+}
+
+/* TX scheduler: one FIFO per priority, the highest non-empty one is sent first */
+enum tx_priority : uint8_t {
+  TX_HIGH = 0,    // drive control commands
+  TX_NORMAL = 1,  // requests of the component and INF commands
+  TX_LOW = 2,     // bulk traffic: diagnostics polling, raw frames by default
+};
+static const uint8_t TX_PRIORITIES = 3;
+static const uint8_t TX_LOW_LIMIT = 64;      // low priority frames waiting at most, the rest is refused
+static const uint16_t RAW_FRAME_MAX = 258;   // 0x55, size, up to 255 bytes, size
+
+/* RX framing: the sender opens every frame with a break, the UART driver reports it as an event and closes the
+   burst with its RX timeout, so a burst is checked as a whole block instead of hunting for 00 55 byte by byte */
+static const uint8_t RX_BURST_TIMEOUT = 3;               // symbols of silence that end a burst, the gap is 6 or more
+static const uint16_t RX_BURST_MAX = RAW_FRAME_MAX + 8;  // one frame with the break bytes and some slack
+
+struct TxScheduler {
+  std::queue<std::vector<uint8_t>> queues[TX_PRIORITIES];
+
+  // false if the frame was refused
+  bool push(std::vector<uint8_t> &&frame, uint8_t priority = TX_NORMAL) {
+    if (priority >= TX_PRIORITIES)
+      priority = TX_LOW;
+    if ((priority == TX_LOW) && (this->queues[TX_LOW].size() >= TX_LOW_LIMIT))
+      return false;
+    this->queues[priority].push(std::move(frame));
+    return true;
+  }
+  bool empty() const { return this->size() == 0; }
+  size_t size() const {
+    size_t size = 0;
+    for (const auto &queue : this->queues)
+      size += queue.size();
+    return size;
+  }
+  void clear() {
+    for (auto &queue : this->queues)
+      queue = {};
+  }
+  // the next frame to send, call only when not empty
+  std::queue<std::vector<uint8_t>> &next() {
+    uint8_t i = 0;
+    while ((i < TX_PRIORITIES - 1) && this->queues[i].empty())
+      i++;
+    return this->queues[i];
+  }
+};
+
+/* Travel-time model for drives without usable encoder feedback: the full travel time of each direction is
+   learned from complete maneuvers, the position is then estimated from the time since the start.
+   The travel is two straight segments split at the knee where the drive slows down; the knee is learned
+   from position samples when the drive reports any, without them the travel is taken as linear */
+static const uint32_t TRAVEL_MIN = 1000;        // ms, shorter or longer complete maneuvers are not learned
+static const uint32_t TRAVEL_MAX = 300000;
+static const float TRAVEL_SMOOTHING = 0.25f;    // weight of the latest maneuver
+static const float TRAVEL_SLOWDOWN = 0.6f;      // a speed below this share of the peak starts the slowdown
+
+struct TravelDirection {
+  uint32_t travel;   // ms for the full travel, 0 - not learned yet
+  float knee_time;   // share of the travel time when the slowdown starts
+  float knee_pos;    // share of the travel done by then
+
+  // share of the travel done after a share of the travel time
+  float pos_at(float time) const {
+    if (time <= this->knee_time)
+      return this->knee_time > 0 ? time * this->knee_pos / this->knee_time : this->knee_pos;
+    return this->knee_pos + (time - this->knee_time) * (1 - this->knee_pos) / (1 - this->knee_time);
+  }
+  // share of the travel time needed for a share of the travel
+  float time_at(float pos) const {
+    if (pos <= this->knee_pos)
+      return this->knee_pos > 0 ? pos * this->knee_time / this->knee_pos : this->knee_time;
+    return this->knee_time + (pos - this->knee_pos) * (1 - this->knee_time) / (1 - this->knee_pos);
+  }
+};
+
+struct TravelModel {
+  TravelDirection dir[2];  // 0 - opening, 1 - closing
+};
+
+/* Motion trace: every maneuver as a start header and samples taken from STA, RUN, INF_STATUS and CUR_POS frames,
+   delta and varint encoded in a fixed buffer that drops the oldest maneuvers.
+   Maneuver: varint start millis(), varint start encoder position, operation byte, then samples:
+   varint (ms since the previous sample << 2 | flags), [status byte, operation byte], [zigzag varint position delta]
+   Dump: version byte, varint millis() at the dump, maneuver count byte, then varint length and bytes of each maneuver
+   (decoder: tools/bus_t4_trace.py) */
+static const uint16_t TRACE_BUFFER = 4096;      // bytes for all maneuvers
+static const uint8_t TRACE_MANEUVERS = 32;      // maneuvers kept at most
+static const uint8_t TRACE_VERSION = 1;
+static const uint8_t TRACE_STATUS = 0x01;       // sample flag: status and operation follow
+static const uint8_t TRACE_POSITION = 0x02;     // sample flag: position delta follows
+
+struct MotionTrace {
+  uint8_t data[TRACE_BUFFER];
+  uint16_t used;                        // bytes of all maneuvers, oldest first
+  uint8_t count;                        // maneuvers stored
+  uint16_t length[TRACE_MANEUVERS];     // bytes of each maneuver, oldest first
+  bool recording;                       // the newest maneuver is still growing
+  uint8_t op;                           // CoverOperation of the newest maneuver
+  uint32_t last_time;                   // previous sample of the newest maneuver
+  uint16_t last_pos;
+  uint8_t last_status;
+};
+
+/* Maintenance analytics: every maneuver is added to a daily and a weekly bin, both rings are kept in flash.
+   Days come from the clock when one is configured, otherwise from the uptime continuing the last stored day.
+   Flash wear: the bins are saved at most once per MAINT_SAVE_INTERVAL and only when they changed, NVS spreads
+   the writes over its pages */
+static const uint8_t MAINT_DAYS = 14;                // daily bins
+static const uint8_t MAINT_WEEKS = 26;               // weekly bins
+static const uint8_t MAINT_RECENT_DAYS = 7;          // days averaged for cycles per day and the duration drift
+static const uint32_t MAINT_DAY = 86400000;          // ms
+static const uint32_t MAINT_SAVE_INTERVAL = 3600000; // ms between flash writes
+
+struct MaintenanceBin {
+  uint16_t day;          // day of the last maneuver counted, days since 1970 or uptime days; 0 - empty
+  uint16_t cycles;       // maneuvers
+  uint16_t stops;        // maneuvers stopped between the end positions
+  uint16_t reversals;    // maneuvers turned into the opposite direction
+  uint16_t complete[2];  // maneuvers from one end position to the other, 0 - opening, 1 - closing
+  uint32_t duration[2];  // ms, sum over these
+  uint16_t peak_speed;   // 0.1 %/s, the highest encoder speed
+  uint16_t speeds;       // maneuvers with an encoder mean speed
+  uint32_t mean_speed;   // 0.1 %/s, sum over these
+};
+
+struct MaintenanceLog {
+  MaintenanceBin days[MAINT_DAYS];    // ring indexed by day
+  MaintenanceBin weeks[MAINT_WEEKS];  // ring indexed by day / 7
+  uint16_t today;                     // current day, the uptime count continues from it after a reboot
+};
+
+/* Sequences of steps declared in YAML, one runs at a time. A wait step ends in the same parse_status_packet() call
+   that decoded the awaited frame, the command of the next step is queued at once */
+static const uint8_t SEQUENCES = 8;
+static const uint8_t SEQUENCE_STEPS = 16;
+
+enum sequence_step : uint8_t {
+  STEP_COMMAND       = 0,  // code - control_cmd
+  STEP_WAIT_STATUS   = 1,  // code - status reported by the drive
+  STEP_WAIT_POSITION = 2,  // value - position in 0.1 %, reached from either side
+  STEP_DELAY         = 3,  // value - ms
+  STEP_SET_REGISTER  = 4,  // code - register, len and value; done once the drive reports the value
+};
+
+struct SequenceStep {
+  uint8_t type;
+  uint8_t code;
+  uint8_t len;
+  uint32_t value;
+  uint32_t timeout;  // ms for a wait step, 0 - no limit
+};
+
+struct Sequence {
+  const char *name;
+  uint8_t count;
+  SequenceStep steps[SEQUENCE_STEPS];
+};
+
+/* Configuration snapshots: the settings registers read into a versioned binary image, exported as base64:
+   version, product hash (4 bytes), entry count, then register, length and big-endian value of each entry.
+   A restore reads the drive first and writes only the registers that differ, REGISTER_WRITES at a time and each
+   verified by its read-back; a diff only reports them. Registers the drive refuses are left out of the image */
+static const uint8_t CONFIG_VERSION = 1;
+static const uint8_t CONFIG_REGISTERS[] = {
+  INF_P_OPN1, INF_P_OPN2, INF_P_OPN3, INF_SLOW_OPN, INF_SLOW_CLS, OPN_OFFSET, CLS_OFFSET, OPN_DIS, CLS_DIS, REV_TIME,
+  SPEED_OPN, SPEED_CLS, SPEED_SLW_OPN, SPEED_SLW_CLS, OPN_PWR, CLS_PWR, OUT1, OUT2, LOCK_TIME, LAMP_TIME, S_CUP_TIME,
+  COMM_SBS, COMM_POPN, COMM_OPN, COMM_CLS, COMM_STP, COMM_PHOTO, COMM_PHOTO2, COMM_PHOTO3, COMM_OPN_STP, COMM_CLS_STP,
+  IN1, IN2, IN3, IN4, COMM_LET_OPN, COMM_LET_CLS,
+  AUTOCLS, P_TIME, PH_CLS_ON, PH_CLS_TIME, PH_CLS_VAR, ALW_CLS_ON, ALW_CLS_TIME, ALW_CLS_VAR, STANDBY_ON, WAIT_TIME,
+  STAND_BY_MODE, START_ON, START_TIME, BLINK_ON, BLINK_OPN_TIME, SLAVE_ON, BLINK_CLS_TIME, KEY_LOCK, SLOW_ON, DIS_VAL,
+};
+static const uint8_t CONFIG_REGISTER_COUNT = sizeof(CONFIG_REGISTERS);
+static const uint32_t CONFIG_READ_TIMEOUT = 2000;  // ms after the GETs are expected to be answered
+static const uint8_t CONFIG_REFUSED = 0xFF;        // length of a register the drive answered with an error
+
+enum config_job : uint8_t {
+  CONFIG_NONE     = 0,
+  CONFIG_SNAPSHOT = 1,
+  CONFIG_DIFF     = 2,
+  CONFIG_RESTORE  = 3,
+};
+
+// indexed like CONFIG_REGISTERS
+struct ConfigImage {
+  uint32_t product_hash;
+  uint8_t len[CONFIG_REGISTER_COUNT];   // value bytes, 0 - unknown, CONFIG_REFUSED - not supported
+  uint32_t value[CONFIG_REGISTER_COUNT];
+};
+
+struct ConfigJob {
+  uint8_t job;
+  bool writing;       // restore: the drive has been read, differing registers are written
+  uint8_t pending;    // GETs not answered yet
+  uint8_t next;       // next register to compare
+  uint8_t writes;     // register writes in progress
+  uint8_t written;
+  uint8_t failed;
+  uint8_t unchanged;
+  uint32_t deadline;  // millis() of the end of reading
+};
+
 enum position_hook_type : uint8_t {
      IGNORE = 0x00,
     STOP_UP = 0x01,
@@ -418,20 +996,111 @@ class NiceBusT4 : public Component, public Cover {
     // NiceBusT4(text_sensor::TextSensor *sensor) : pause_time_sensor(sensor) {}  // Konstruktor przyjmujący wskaźnik do text_sensor
     
     bool init_ok = false;  // drive detection when turned on
-    bool is_walky = false; // the position request command is different for walky
-    bool is_robus = false; // for Robus there is no need to periodically request a position
+    void set_drive(uint8_t family);  // fixed profile, otherwise found from the product
+    const char *get_drive() const { return this->drive_->name; }
     
     void setup() override;
     void loop() override;
     void dump_config() override; // to log information about equipment
 
-    void send_raw_cmd(std::string data);
-    void send_cmd(uint8_t data) {this->tx_buffer_.push(gen_control_cmd(data));} 
+    // raw frame in hex, bytes may be separated by spaces, periods, colons or dashes
+    // fix_crc recomputes size, mes_size, CRC1 and CRC2; false if the input is malformed or the queue is full
+    bool send_raw_cmd(const std::string &data, uint8_t priority = TX_LOW, bool fix_crc = false);
+    // binary frame from 0x55 to the size byte; false unless size, CRC1 and CRC2 are right or if the queue is full
+    bool send_frame(const uint8_t *frame, size_t len, uint8_t priority = TX_LOW);
+    void send_cmd(uint8_t data) {this->tx_buffer_.push(gen_control_cmd(data), TX_HIGH);} 
+    // SET of a drive register with a verifying GET, done(true) once the drive reports the value
+    void set_register(uint8_t reg, uint32_t value, uint8_t len = 1, std::function<void(uint8_t)> &&done = nullptr);
+    // queue a frame and call done with its answer; false, without calling done, if the frame was refused
+    bool send_awaited(std::vector<uint8_t> &&frame, uint8_t priority, uint32_t timeout, AwaitCallback &&done);
+    bool send_raw_cmd(const std::string &data, uint8_t priority, bool fix_crc, uint32_t timeout, AwaitCallback &&done);
+    bool send_command(uint8_t cmd, uint32_t timeout, AwaitCallback &&done) {
+      return this->send_awaited(gen_control_cmd(cmd), TX_HIGH, timeout, std::move(done));
+    }
+    bool get_register(uint8_t reg, uint32_t timeout, AwaitCallback &&done) {
+      return this->send_awaited(gen_inf_cmd(FOR_CU, reg, GET), TX_NORMAL, timeout, std::move(done));
+    }
     void send_inf_cmd(std::string to_addr, std::string whose, std::string command, std::string type_command,  std::string next_data, bool data_on, std::string data_command); // long command
     void set_mcu(std::string command, std::string data_command); // command to motor controller
     // void check_cmd();  
 
     void set_class_gate(uint8_t class_gate) { class_gate_ = class_gate; }
+
+    // sequences declared in YAML; run_sequence() stops a running one, false if the name is unknown
+    void add_sequence(const char *name);
+    void add_sequence_step(uint8_t type, uint8_t code, uint8_t len, uint32_t value, uint32_t timeout);  // to the last one
+    bool run_sequence(const std::string &name);
+    void stop_sequence();
+    void add_on_sequence_callback(std::function<void(const std::string &, bool)> &&callback) { this->sequence_callback_.add(std::move(callback)); }
+
+    // registers, status, remote control presses and errors as they are decoded; false if MAX_LISTENERS are subscribed
+    bool add_listener(BusT4Listener *listener);
+
+    // diagnostics: INF_IO, DIAG_BB and DIAG_PAR are polled only while somebody listens
+    void set_diag_budget(float budget) { this->diag_spacing_ = budget > 0 ? DIAG_POLL_BUS_TIME / budget : 0; } // share of bus time, 0..1
+    void request_diagnostics();  // one-off read of all diagnostics registers
+    // idle watch: INF_STATUS probes while idle, 0 - off
+    void set_idle_watch_interval(uint32_t interval) { this->idle_max_ = interval; }  // ms, longest interval
+    void set_idle_watch_budget(float budget) { this->idle_spacing_ = budget > 0 ? DIAG_POLL_BUS_TIME / budget : 0; }
+    // bus metrics, cumulative since boot
+    const BusMetrics &get_metrics() const { return this->metrics_; }
+    const DeviceLatency *get_device_latency(uint16_t address) const;  // nullptr until the device has answered
+    uint16_t get_to_address() const { return (this->addr_to[0] << 8) | this->addr_to[1]; }
+
+    // bus benchmark, normal traffic waits in the queue while it runs
+    void start_benchmark(uint8_t reg, uint16_t count, bool apply);
+    void add_on_benchmark_callback(std::function<void(const std::string &)> &&callback) { this->benchmark_callback_.add(std::move(callback)); }
+    void set_tx_gap(uint32_t tx_gap) { this->tx_gap_ = tx_gap; }  // us of bus silence before we transmit
+    // position publishes in motion; operation changes and the position at rest are published at once
+    void set_position_deadband(float deadband) { this->position_deadband_ = deadband; }  // 0..1
+    void set_position_interval(uint32_t interval) { this->position_interval_ = interval; }  // ms
+
+    // bus census, the slots with addr 0x0000 are free
+    const CensusDevice *get_census() const { return this->census_; }
+    void dump_census();  // as a table in the log and as JSON to on_census
+    void add_on_census_callback(std::function<void(const std::string &)> &&callback) { this->census_callback_.add(std::move(callback)); }
+
+    bool is_bus_healthy() const { return this->wd_.level == 0; }  // false while the watchdog recovers
+
+    // travel-time model: seconds until the current maneuver completes, 0 at rest, NAN until the travel is learned
+    float get_eta() const;
+
+    // motion trace of the last maneuvers, base64 of the dump format described at MotionTrace
+    void dump_trace();
+    void add_on_trace_callback(std::function<void(const std::string &)> &&callback) { this->trace_callback_.add(std::move(callback)); }
+    const TravelModel &get_travel_model() const { return this->travel_; }
+
+    // maintenance analytics, NAN while there is not enough data
+    float get_cycles_per_day() const;      // over the last complete days
+    float get_duration_drift() const;      // % change of the complete maneuver time against the oldest week
+    float get_cycles_until_service() const;  // service interval minus P_COUNT
+    const MaintenanceLog &get_maintenance_log() const { return this->maint_; }
+    void set_service_interval(uint32_t cycles) { this->service_interval_ = cycles; }  // 0 - unknown
+    void cancel_maintenance();  // C_MAIN, the drive restarts its partial counter
+
+    // configuration snapshots; the callback gets a JSON report and the base64 image of the drive's registers.
+    // false if another snapshot job runs or the text is not a valid image
+    bool snapshot_config();
+    bool diff_config(const std::string &snapshot);
+    bool restore_config(const std::string &snapshot);
+    void add_on_config_callback(std::function<void(const std::string &, const std::string &)> &&callback) { this->config_callback_.add(std::move(callback)); }
+#ifdef USE_TIME
+    void set_time(time::RealTimeClock *time) { this->time_ = time; }
+#endif
+
+    void watch_register(uint8_t reg);  // read at initialization and by refresh_registers()
+    void refresh_registers();          // GET of every watched register, entities publish the values that changed
+
+    // every frame sent and received, CRC failures included; keep it short, it runs in the bus loop
+    void add_on_frame_callback(std::function<void(uint8_t, const uint8_t *, size_t, uint8_t)> &&callback) {
+      this->frame_callback_.add(std::move(callback));
+    }
+
+    // callback(register, payload, length, changed bits of each payload byte), called only when the payload changes
+    void add_on_diag_callback(std::function<void(uint8_t, const uint8_t *, uint8_t, const uint8_t *)> &&callback) {
+      this->diag_callback_.add(std::move(callback));
+      this->diag_subscribers_++;
+    }
     
  /*   void set_update_interval(uint32_t update_interval) {  // drive status acquisition interval
       this->update_interval_ = update_interval;
@@ -448,10 +1117,115 @@ class NiceBusT4 : public Component, public Cover {
     uint32_t last_position_time{0};  // Time of last update of current position
     uint32_t update_interval_{500};
     uint32_t last_update_{0};
-    uint32_t last_uart_byte_{0};
+    uint32_t tx_gap_{3000};  // us of bus silence before sending
+
+    void remember_sent_(const uint8_t *data, size_t len);
+    bool drop_echo_(const std::vector<uint8_t> &data);  // true for the echo of a sent frame
+    void check_echoes_();                               // sent frames whose echo did not come
+    void echo_missing_frame_();
+    SentFrame sent_[ECHO_FRAMES]{};
+    uint8_t sent_next_{0};
+    bool echo_seen_{false};       // the wiring echoes, missing echoes mean the frame did not reach the line
+    uint8_t echo_missing_{0};     // in a row, saturates at ECHO_MISSING_WARN
+
+    CallbackManager<void(uint8_t, const uint8_t *, size_t, uint8_t)> frame_callback_;  // direction, frame, length, status
+
+    void watchdog_();                                    // fault detection and recovery steps
+    void watchdog_rx_(const std::vector<uint8_t> &data);  // valid frame, a frame of the drive ends a fault
+    void watchdog_step_();
+    BusWatchdog wd_{};
+
+    bool bus_idle_();                                    // the arbiter allows us to transmit
+    void arbitrate_(const std::vector<uint8_t> &data);   // received frame, follows the exchanges of the bus
+    BusArbiter arb_{};
+    HighFrequencyLoopRequester tx_loop_;  // loop() runs without the usual 16 ms pause while frames wait
 
     CoverOperation last_published_op;  // Latest published status and position
     float last_published_pos{-1};
+    uint32_t last_published_time_{0};  // millis() of the last position publish in motion
+
+    const DriveProfile *drive_{nullptr};  // set in setup() unless chosen in YAML
+    bool drive_fixed_{false};
+    bool has_encoder_() const { return this->drive_->poll_position && (this->_max_opn != 0); }  // positions come from the drive
+    float progress_(CoverOperation op) const { return op == COVER_OPERATION_CLOSING ? 1 - this->position : this->position; }
+    void update_travel_();                     // follows maneuvers, estimates the position without an encoder
+    void learn_travel_(uint32_t duration);     // a complete maneuver of motion_op_
+    void sample_travel_(uint32_t now);         // encoder sample, looks for the slowdown knee
+    TravelModel travel_{{{0, 1, 1}, {0, 1, 1}}};
+    ESPPreferenceObject travel_pref_;
+    CoverOperation motion_op_{COVER_OPERATION_IDLE};  // maneuver being followed
+    uint32_t motion_start_{0};        // millis()
+    float motion_from_{0};            // share of the travel done at the start
+    bool motion_full_{false};         // started at the end position, a complete maneuver can be learned
+    uint32_t sample_time_{0};         // previous encoder sample, ms since the start
+    float sample_pos_{0};
+    float peak_speed_{0};             // share of the travel per ms
+    bool knee_found_{false};
+    uint32_t knee_time_{0};           // ms since the start
+    float knee_pos_{0};
+    float position_target_{NAN};      // arbitrary position requested, NAN - an end position
+
+    void record_cycle_(CoverOperation next, uint32_t duration);  // motion_op_ ended, next is the new operation
+    uint16_t maint_today_();
+    MaintenanceBin &maint_bin_(MaintenanceBin *ring, uint8_t size, uint8_t days, uint16_t day);
+    void maint_loop_();             // current day and flash writes
+    MaintenanceLog maint_{};
+    ESPPreferenceObject maint_pref_;
+    bool maint_dirty_{false};
+    uint32_t maint_saved_{0};       // millis() of the last flash write
+    uint32_t maint_checked_{0};     // millis() of the last maint_loop_() run, once a minute
+    uint32_t maint_day_start_{0};   // millis() when the uptime day began
+    uint32_t service_interval_{0};  // cycles between services
+    bool p_count_known_{false};
+#ifdef USE_TIME
+    time::RealTimeClock *time_{nullptr};
+#endif
+
+    void census_frame_(const std::vector<uint8_t> &data);  // every valid frame
+    void census_loop_();
+    CensusDevice census_[CENSUS_DEVICES]{};
+    uint32_t census_scan_{0};       // millis() of the start of the last WHO round
+    uint8_t census_round_{CENSUS_DEVICES};  // next slot asked in the WHO round, CENSUS_DEVICES - none running
+    uint32_t discovery_time_{0};    // millis() of the last discovery WHO
+    uint32_t census_request_{0};    // millis() of the last census request
+    uint32_t census_window_{0};     // millis() of the start of the rate window
+    CallbackManager<void(const std::string &)> census_callback_;
+
+    bool config_start_(uint8_t job);
+    bool config_decode_(const std::string &snapshot);  // into config_target_
+    std::string config_encode_(const ConfigImage &image) const;
+    void config_reply_(const std::vector<uint8_t> &data);  // GET replies while reading
+    void config_loop_();
+    void config_read_done_();
+    void config_write_next_();
+    void config_finish_(const std::string &report);
+    ConfigJob config_{};
+    ConfigImage config_drive_{};    // read from the drive
+    ConfigImage config_target_{};   // decoded snapshot of a diff or restore
+    CallbackManager<void(const std::string &, const std::string &)> config_callback_;
+
+    void sequence_next_();                // runs steps until one has to wait
+    void sequence_status_(uint8_t status);
+    void sequence_loop_();                // delays, positions and timeouts
+    void sequence_end_(bool ok);
+    bool sequence_position_reached_(const SequenceStep &step) const;
+    Sequence sequences_[SEQUENCES]{};
+    uint8_t sequence_count_{0};
+    Sequence *seq_{nullptr};              // running sequence
+    uint8_t seq_step_{0};
+    uint32_t seq_step_start_{0};          // millis()
+    bool seq_rising_{false};              // the awaited position is above the position at the step start
+    uint8_t seq_run_{0};                  // changes with every start and end, late register callbacks are ignored
+    CallbackManager<void(const std::string &, bool)> sequence_callback_;
+
+    void trace_follow_();                             // starts and ends maneuvers on changes of current_operation
+    void trace_sample_(int16_t status, int32_t pos);  // -1 - not in this frame
+    void trace_record_(int16_t status, int32_t pos);  // sample of the newest maneuver
+    bool trace_put_(const uint8_t *bytes, uint8_t len);
+    MotionTrace trace_{};
+    CallbackManager<void(const std::string &)> trace_callback_;  // base64 dump, on_trace
+    float position_deadband_{0.01};    // position change needed for a publish in motion
+    uint32_t position_interval_{500};  // ms between position publishes in motion
 
     void publish_state_if_changed(void);
 
@@ -477,7 +1251,9 @@ class NiceBusT4 : public Component, public Cover {
     uint8_t addr_to[2]; // = 0x00ff;   // to whom is the package, the address of the drive controller we are controlling
     uint8_t addr_oxi[2]; // = 0x000a;  // receiver address
 
-    std::vector<uint8_t> raw_cmd_prepare (std::string data);             // preparing user-entered data for sending
+    std::vector<uint8_t> raw_cmd_prepare (const std::string &data);      // preparing user-entered data for sending, empty if malformed
+    size_t parse_hex_(const std::string &text, uint8_t *out, size_t max); // bytes written, 0 if malformed or too long
+    void fix_frame_(uint8_t *frame, size_t len);                         // recompute size, mes_size, CRC1 and CRC2
 
     // генерация inf команд
     std::vector<uint8_t> gen_inf_cmd(const uint8_t to_addr1, const uint8_t to_addr2, const uint8_t whose, const uint8_t inf_cmd, const uint8_t run_cmd, const uint8_t next_data, const std::vector<uint8_t> &data, size_t len);  // all fields
@@ -496,24 +1272,77 @@ class NiceBusT4 : public Component, public Cover {
 
 
     void parse_status_packet (const std::vector<uint8_t> &data); // parsing the status package
+    bool parse_remote_packet_(const std::vector<uint8_t> &data);   // OXI button read, returns true if it was one
+
+
+    void track_request_(const uint8_t *data, size_t len);  // remember a sent request to time its reply
+    void track_reply_(const std::vector<uint8_t> &data);  // match a received frame against sent requests
+    DeviceLatency *device_latency_(uint8_t addr1, uint8_t addr2);
+    BusMetrics metrics_{};
+    PendingRequest pending_[PENDING_REQUESTS]{};
+
+    void send_register_write_(RegisterWrite &write);
+    bool register_write_free_(uint8_t reg) const;
+    void verify_register_write_(const std::vector<uint8_t> &data);  // SET and GET replies of the drive
+    void check_register_writes_();                                   // timeouts and retries
+    void finish_register_write_(RegisterWrite &write, uint8_t result);
+    RegisterWrite writes_[REGISTER_WRITES]{};
+
+    void complete_awaited_(const std::vector<uint8_t> &data);  // answers to awaited requests
+    void expire_awaited_();
+    AwaitedRequest awaited_[AWAITED_REQUESTS]{};
+
+    void run_benchmark_();                                      // benchmark step from loop()
+    bool benchmark_reply_(const std::vector<uint8_t> &data);   // true if the frame answered a benchmark GET
+    void benchmark_send_(uint8_t slot);
+    bool benchmark_line_free_();                               // no frame on the line and no exchange of another master
+    void finish_benchmark_stage_();
+    void report_benchmark_();
+    Benchmark bench_{};
+    HighFrequencyLoopRequester bench_loop_;   // loop() runs without the usual 16 ms pause during a benchmark
+    CallbackManager<void(const std::string &)> benchmark_callback_;
+    bool quiet_{false};                       // no per-frame logging, it would distort timings
+
+    void poll_diagnostics_();                                         // next diagnostics GET if the budget allows
+    void update_diag_(uint8_t reg, const uint8_t *data, uint8_t len); // store payload, notify about changed bits
+    DiagPayload diag_[DIAG_COUNT]{};
+    uint8_t diag_next_{0};          // register polled next
+    uint8_t diag_subscribers_{0};
+    uint32_t diag_spacing_{500};    // ms between diagnostics GETs, 0 - no polling
+    uint32_t last_diag_poll_{0};
+    CallbackManager<void(uint8_t, const uint8_t *, uint8_t, const uint8_t *)> diag_callback_;
+
+    void idle_watch_();                                   // next INF_STATUS probe from loop()
+    void idle_watch_reply_(const std::vector<uint8_t> &data);
+    uint32_t idle_max_{1000};        // ms between probes once nothing changes, 0 - no probes
+    uint32_t idle_spacing_{500};     // ms, the bus-time budget of the steady probes
+    uint32_t idle_interval_{IDLE_WATCH_MIN};
+    uint32_t last_idle_probe_{0};
+    uint8_t idle_status_{0xFF};      // last status of the drive, 0xFF - none yet
+
+    void notify_reply_(const std::vector<uint8_t> &data);  // INF replies to on_register / on_error
+    void notify_status_(const std::vector<uint8_t> &data, uint8_t status);
+    BusT4Listener *listeners_[MAX_LISTENERS];
+    uint8_t listener_count_{0};
+    uint8_t watched_[WATCHED_REGISTERS];
+    uint8_t watched_count_{0};
     
     void handle_char_(uint8_t c);                                         // received byte handler
+    void open_uart_();                                                   // UART and its event queue, on setup and recovery
+    void read_events_();                                                 // bursts delimited by the UART driver
+    void handle_burst_();                                                // frames of a complete burst
+    bool frame_received_();                                              // a checked frame in rx_message_
+    QueueHandle_t rx_events_{nullptr};                                   // nullptr - no events, bytes go to handle_char_
+    uint8_t burst_[RX_BURST_MAX];
+    uint16_t burst_len_{0};
     void handle_datapoint_(const uint8_t *buffer, size_t len);          // received data processor
     bool validate_message_();                                         // function to check received message
 
     std::vector<uint8_t> rx_message_;                          // here the received message is accumulated byte by byte
-    std::queue<std::vector<uint8_t>> tx_buffer_;             // queue of commands to send
-    bool ready_to_tx_{true};                             // flag for sending commands
+    TxScheduler tx_buffer_;                                  // queues of commands to send, by priority
   
-    std::vector<uint8_t> manufacturer_ = {0x55, 0x55};  // unknown manufacturer upon initialization
-    std::vector<uint8_t> product_;
-    std::vector<uint8_t> hardware_;
-    std::vector<uint8_t> firmware_;
-    std::vector<uint8_t> description_;  
-    std::vector<uint8_t> oxi_product;
-    std::vector<uint8_t> oxi_hardware;
-    std::vector<uint8_t> oxi_firmware;
-    std::vector<uint8_t> oxi_description; 
+    DeviceIdentity identity_;                             // manufacturer, product, versions of the drive and the receiver
+    void set_identity_(uint8_t drive_field, uint8_t oxi_field, const std::vector<uint8_t> &data);
 
 }; //Class
 
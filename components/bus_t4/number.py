@@ -0,0 +1,37 @@
+import esphome.codegen as cg
+import esphome.config_validation as cv
+from esphome.components import number
+from esphome.const import CONF_MAX_VALUE, CONF_MIN_VALUE, CONF_STEP
+
+from . import bus_t4_ns, BUS_T4_CHILD_SCHEMA, CONF_BUS_T4_ID, CONF_REGISTER, CONF_LENGTH
+
+DEPENDENCIES = ['bus_t4']
+
+BusT4Number = bus_t4_ns.class_('BusT4Number', number.Number, cg.Component)
+
+
+def validate_range(config):
+    if config[CONF_MIN_VALUE] > config[CONF_MAX_VALUE]:
+        raise cv.Invalid("'max_value' must not be below 'min_value'")
+    if config[CONF_MAX_VALUE] >= 1 << (8 * config[CONF_LENGTH]):
+        raise cv.Invalid("'max_value' does not fit in %d bytes" % config[CONF_LENGTH])
+    return config
+
+
+CONFIG_SCHEMA = cv.All(number.number_schema(BusT4Number).extend({
+    cv.Required(CONF_REGISTER): cv.hex_uint8_t,
+    cv.Optional(CONF_LENGTH, default=1): cv.int_range(min=1, max=4),  # value bytes
+    cv.Optional(CONF_MIN_VALUE, default=0): cv.positive_int,
+    cv.Optional(CONF_MAX_VALUE, default=255): cv.positive_int,
+    cv.Optional(CONF_STEP, default=1): cv.positive_not_null_int,
+}).extend(BUS_T4_CHILD_SCHEMA).extend(cv.COMPONENT_SCHEMA), validate_range)
+
+
+def to_code(config):
+    var = yield number.new_number(config, min_value=config[CONF_MIN_VALUE], max_value=config[CONF_MAX_VALUE],
+                                  step=config[CONF_STEP])
+    yield cg.register_component(var, config)
+
+    parent = yield cg.get_variable(config[CONF_BUS_T4_ID])
+    cg.add(var.set_bus_t4_parent(parent))
+    cg.add(var.set_register(config[CONF_REGISTER], config[CONF_LENGTH]))
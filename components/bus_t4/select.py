@@ -0,0 +1,39 @@
+import esphome.codegen as cg
+import esphome.config_validation as cv
+from esphome.components import select
+from esphome.const import CONF_OPTIONS
+
+from . import bus_t4_ns, BUS_T4_CHILD_SCHEMA, CONF_BUS_T4_ID, CONF_REGISTER
+
+DEPENDENCIES = ['bus_t4']
+
+BusT4Select = bus_t4_ns.class_('BusT4Select', select.Select, cg.Component)
+
+
+# register value: option text, in the order of the options
+def validate_options(value):
+    if not isinstance(value, dict) or not value:
+        raise cv.Invalid("Expected register values with their option texts, e.g. '1: Open - stop - close'")
+    options = {}
+    for key, text in value.items():
+        options[cv.uint8_t(key)] = cv.string_strict(text)
+    if len(set(options.values())) != len(options):
+        raise cv.Invalid("Option texts must be unique")
+    return options
+
+
+CONFIG_SCHEMA = select.select_schema(BusT4Select).extend({
+    cv.Required(CONF_REGISTER): cv.hex_uint8_t,
+    cv.Required(CONF_OPTIONS): validate_options,
+}).extend(BUS_T4_CHILD_SCHEMA).extend(cv.COMPONENT_SCHEMA)
+
+
+def to_code(config):
+    options = config[CONF_OPTIONS]
+    var = yield select.new_select(config, options=list(options.values()))
+    yield cg.register_component(var, config)
+
+    parent = yield cg.get_variable(config[CONF_BUS_T4_ID])
+    cg.add(var.set_bus_t4_parent(parent))
+    cg.add(var.set_register(config[CONF_REGISTER]))
+    cg.add(var.set_values(list(options.keys())))
@@ -0,0 +1,150 @@
+import esphome.codegen as cg
+import esphome.config_validation as cv
+from esphome.components import sensor
+from esphome.const import (
+    CONF_ADDRESS,
+    CONF_TYPE,
+    DEVICE_CLASS_DURATION,
+    ENTITY_CATEGORY_DIAGNOSTIC,
+    STATE_CLASS_MEASUREMENT,
+    STATE_CLASS_TOTAL_INCREASING,
+)
+
+from . import bus_t4_ns, BUS_T4_CHILD_SCHEMA, CONF_BUS_T4_ID, CONF_REGISTER, CONF_LENGTH
+
+DEPENDENCIES = ['bus_t4']
+
+CONF_STATISTIC = 'statistic'
+
+BusT4MetricSensor = bus_t4_ns.class_('BusT4MetricSensor', sensor.Sensor, cg.PollingComponent)
+BusT4RegisterSensor = bus_t4_ns.class_('BusT4RegisterSensor', sensor.Sensor, cg.Component)
+BusT4EtaSensor = bus_t4_ns.class_('BusT4EtaSensor', sensor.Sensor, cg.PollingComponent)
+BusT4MaintenanceSensor = bus_t4_ns.class_('BusT4MaintenanceSensor', sensor.Sensor, cg.PollingComponent)
+MaintenanceType = bus_t4_ns.enum('MaintenanceType')
+MetricType = bus_t4_ns.enum('MetricType')
+MetricStatistic = bus_t4_ns.enum('MetricStatistic')
+
+METRIC_TYPES = {
+    'rx_rate': MetricType.METRIC_RX_RATE,
+    'tx_rate': MetricType.METRIC_TX_RATE,
+    'crc1_errors': MetricType.METRIC_CRC1_ERRORS,
+    'crc2_errors': MetricType.METRIC_CRC2_ERRORS,
+    'size_errors': MetricType.METRIC_SIZE_ERRORS,
+    'lost_replies': MetricType.METRIC_LOST_REPLIES,
+    'other_requests': MetricType.METRIC_OTHER_REQUESTS,
+    'echoes': MetricType.METRIC_ECHOES,
+    'missing_echoes': MetricType.METRIC_MISSING_ECHOES,
+    'recoveries': MetricType.METRIC_RECOVERIES,
+    'recovery_time': MetricType.METRIC_RECOVERY_TIME,
+    'bus_devices': MetricType.METRIC_BUS_DEVICES,
+    'tx_queue': MetricType.METRIC_TX_QUEUE,
+    'tx_queue_high_water': MetricType.METRIC_TX_QUEUE_HIGH_WATER,
+    'rsp_latency': MetricType.METRIC_RSP_LATENCY,
+    'evt_latency': MetricType.METRIC_EVT_LATENCY,
+    'loop_time': MetricType.METRIC_LOOP_TIME,
+    'send_time': MetricType.METRIC_SEND_TIME,
+}
+
+MAINTENANCE_TYPES = {
+    'cycles_per_day': MaintenanceType.MAINT_CYCLES_PER_DAY,
+    'duration_drift': MaintenanceType.MAINT_DURATION_DRIFT,
+    'cycles_until_service': MaintenanceType.MAINT_CYCLES_UNTIL_SERVICE,
+    'days_until_service': MaintenanceType.MAINT_DAYS_UNTIL_SERVICE,
+}
+
+STATISTICS = {
+    'mean': MetricStatistic.STAT_MEAN,
+    'p95': MetricStatistic.STAT_P95,
+    'max': MetricStatistic.STAT_MAX,
+}
+
+
+def metric_schema(unit, accuracy, state_class=STATE_CLASS_MEASUREMENT, histogram=False, device=False):
+    schema = sensor.sensor_schema(
+        BusT4MetricSensor,
+        unit_of_measurement=unit,
+        accuracy_decimals=accuracy,
+        state_class=state_class,
+        entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+    ).extend(BUS_T4_CHILD_SCHEMA).extend(cv.polling_component_schema('60s'))
+    if histogram:
+        schema = schema.extend({cv.Optional(CONF_STATISTIC, default='mean'): cv.enum(STATISTICS, lower=True)})
+    if device:
+        schema = schema.extend({cv.Optional(CONF_ADDRESS): cv.hex_uint16_t})  # default - the drive unit
+    return schema
+
+
+# register of the drive, published when its value changes
+REGISTER_SCHEMA = sensor.sensor_schema(BusT4RegisterSensor, accuracy_decimals=0).extend({
+    cv.Required(CONF_REGISTER): cv.hex_uint8_t,
+    cv.Optional(CONF_LENGTH, default=1): cv.int_range(min=1, max=4),  # value bytes
+}).extend(BUS_T4_CHILD_SCHEMA).extend(cv.COMPONENT_SCHEMA)
+
+
+# seconds until the maneuver completes, from the learned travel times
+ETA_SCHEMA = sensor.sensor_schema(
+    BusT4EtaSensor,
+    unit_of_measurement='s',
+    accuracy_decimals=0,
+    device_class=DEVICE_CLASS_DURATION,
+).extend(BUS_T4_CHILD_SCHEMA).extend(cv.polling_component_schema('1s'))
+
+
+def maintenance_schema(unit, accuracy):
+    return sensor.sensor_schema(
+        BusT4MaintenanceSensor,
+        unit_of_measurement=unit,
+        accuracy_decimals=accuracy,
+        state_class=STATE_CLASS_MEASUREMENT,
+    ).extend(BUS_T4_CHILD_SCHEMA).extend(cv.polling_component_schema('60s'))
+
+
+CONFIG_SCHEMA = cv.typed_schema({
+    'register': REGISTER_SCHEMA,
+    'eta': ETA_SCHEMA,
+    'cycles_per_day': maintenance_schema('cycles/d', 1),
+    'duration_drift': maintenance_schema('%', 1),
+    'cycles_until_service': maintenance_schema('cycles', 0),
+    'days_until_service': maintenance_schema('d', 0),
+    'rx_rate': metric_schema('frames/s', 1),
+    'tx_rate': metric_schema('frames/s', 1),
+    'crc1_errors': metric_schema('', 0, STATE_CLASS_TOTAL_INCREASING),
+    'crc2_errors': metric_schema('', 0, STATE_CLASS_TOTAL_INCREASING),
+    'size_errors': metric_schema('', 0, STATE_CLASS_TOTAL_INCREASING),
+    'lost_replies': metric_schema('', 0, STATE_CLASS_TOTAL_INCREASING),
+    'other_requests': metric_schema('', 0, STATE_CLASS_TOTAL_INCREASING),
+    'echoes': metric_schema('', 0, STATE_CLASS_TOTAL_INCREASING),
+    'missing_echoes': metric_schema('', 0, STATE_CLASS_TOTAL_INCREASING),
+    'recoveries': metric_schema('', 0, STATE_CLASS_TOTAL_INCREASING),
+    'recovery_time': metric_schema('ms', 0),
+    'bus_devices': metric_schema('', 0),
+    'tx_queue': metric_schema('', 0),
+    'tx_queue_high_water': metric_schema('', 0),
+    'rsp_latency': metric_schema('ms', 0, histogram=True, device=True),
+    'evt_latency': metric_schema('ms', 0, histogram=True, device=True),
+    'loop_time': metric_schema('us', 0, histogram=True),
+    'send_time': metric_schema('us', 0, histogram=True),
+}, key=CONF_TYPE, lower=True)
+
+
+def to_code(config):
+    var = yield sensor.new_sensor(config)
+    yield cg.register_component(var, config)
+
+    parent = yield cg.get_variable(config[CONF_BUS_T4_ID])
+    cg.add(var.set_bus_t4_parent(parent))
+
+    if config[CONF_TYPE] == 'register':
+        cg.add(var.set_register(config[CONF_REGISTER], config[CONF_LENGTH]))
+        return
+    if config[CONF_TYPE] == 'eta':
+        return
+    if config[CONF_TYPE] in MAINTENANCE_TYPES:
+        cg.add(var.set_type(MAINTENANCE_TYPES[config[CONF_TYPE]]))
+        return
+    cg.add(var.set_type(METRIC_TYPES[config[CONF_TYPE]]))
+
+    if CONF_STATISTIC in config:
+        cg.add(var.set_statistic(config[CONF_STATISTIC]))
+    if CONF_ADDRESS in config:
+        cg.add(var.set_address(config[CONF_ADDRESS]))
@@ -0,0 +1,22 @@
+import esphome.codegen as cg
+import esphome.config_validation as cv
+from esphome.components import switch
+
+from . import bus_t4_ns, BUS_T4_CHILD_SCHEMA, CONF_BUS_T4_ID, CONF_REGISTER
+
+DEPENDENCIES = ['bus_t4']
+
+BusT4Switch = bus_t4_ns.class_('BusT4Switch', switch.Switch, cg.Component)
+
+CONFIG_SCHEMA = switch.switch_schema(BusT4Switch).extend({
+    cv.Required(CONF_REGISTER): cv.hex_uint8_t,  # 0 - off, anything else - on
+}).extend(BUS_T4_CHILD_SCHEMA).extend(cv.COMPONENT_SCHEMA)
+
+
+def to_code(config):
+    var = yield switch.new_switch(config)
+    yield cg.register_component(var, config)
+
+    parent = yield cg.get_variable(config[CONF_BUS_T4_ID])
+    cg.add(var.set_bus_t4_parent(parent))
+    cg.add(var.set_register(config[CONF_REGISTER]))
@@ -0,0 +1,36 @@
+import esphome.codegen as cg
+import esphome.config_validation as cv
+from esphome.components import text_sensor
+
+from . import bus_t4_ns, BUS_T4_CHILD_SCHEMA, CONF_BUS_T4_ID, CONF_REGISTER, CONF_LENGTH
+
+DEPENDENCIES = ['bus_t4']
+
+CONF_VALUES = 'values'
+
+BusT4TextSensor = bus_t4_ns.class_('BusT4TextSensor', text_sensor.TextSensor, cg.Component)
+
+
+# register value: text, values without a text are shown as numbers
+def validate_values(value):
+    if not isinstance(value, dict):
+        raise cv.Invalid("Expected register values with their texts")
+    return {cv.uint32_t(key): cv.string_strict(text) for key, text in value.items()}
+
+
+CONFIG_SCHEMA = text_sensor.text_sensor_schema(BusT4TextSensor).extend({
+    cv.Required(CONF_REGISTER): cv.hex_uint8_t,
+    cv.Optional(CONF_LENGTH, default=1): cv.int_range(min=1, max=4),  # value bytes
+    cv.Optional(CONF_VALUES, default={}): validate_values,
+}).extend(BUS_T4_CHILD_SCHEMA).extend(cv.COMPONENT_SCHEMA)
+
+
+def to_code(config):
+    var = yield text_sensor.new_text_sensor(config)
+    yield cg.register_component(var, config)
+
+    parent = yield cg.get_variable(config[CONF_BUS_T4_ID])
+    cg.add(var.set_bus_t4_parent(parent))
+    cg.add(var.set_register(config[CONF_REGISTER], config[CONF_LENGTH]))
+    for value, text in config[CONF_VALUES].items():
+        cg.add(var.add_value(value, text))
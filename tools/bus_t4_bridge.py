@@ -0,0 +1,63 @@
+#!/usr/bin/env python3
+"""Client of the bus_t4 TCP bridge: prints the frames of the bus and sends frames typed as hex lines.
+
+usage: bus_t4_bridge.py HOST [PORT] [--fix]
+
+Every frame on the connection is preceded by its length and a direction byte (0 - received from the bus,
+1 - sent by the gateway). Typed frames go from 0x55 to the size byte, bytes may be separated by spaces;
+--fix recomputes size, mes_size, CRC1 and CRC2 before sending.
+"""
+import select
+import socket
+import sys
+import time
+
+DIRECTIONS = {0: 'rx', 1: 'tx'}
+
+
+def fix_frame(frame):
+    frame[1] = len(frame) - 3
+    frame[7] = len(frame) - 10
+    frame[8] = 0
+    for b in frame[2:8]:
+        frame[8] ^= b
+    frame[-2] = 0
+    for b in frame[9:-2]:
+        frame[-2] ^= b
+    frame[-1] = len(frame) - 3
+    return frame
+
+
+def main():
+    args = [a for a in sys.argv[1:] if not a.startswith('--')]
+    fix = '--fix' in sys.argv
+    if not args:
+        sys.exit(__doc__)
+    conn = socket.create_connection((args[0], int(args[1]) if len(args) > 1 else 6638))
+    conn.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+    buf = b''
+    while True:
+        ready, _, _ = select.select([conn, sys.stdin], [], [])
+        if sys.stdin in ready:
+            line = sys.stdin.readline()
+            if not line:
+                return
+            frame = bytearray.fromhex(line.replace(':', ' ').replace('.', ' ').replace('-', ' '))
+            if not frame:
+                continue
+            if fix:
+                fix_frame(frame)
+            conn.sendall(bytes([len(frame), 1]) + frame)
+        if conn in ready:
+            data = conn.recv(4096)
+            if not data:
+                return
+            buf += data
+            while len(buf) >= 2 and len(buf) >= 2 + buf[0]:
+                frame = buf[2:2 + buf[0]]
+                print('%.3f %s %s' % (time.time(), DIRECTIONS.get(buf[1], '?'), frame.hex(' ').upper()), flush=True)
+                buf = buf[2 + buf[0]:]
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,71 @@
+#!/usr/bin/env python3
+"""Decode a bus_t4 motion trace (base64 from on_trace or the log) into CSV.
+
+usage: bus_t4_trace.py TRACE | bus_t4_trace.py < trace.txt
+
+Columns: maneuver, time in ms since the start of the maneuver, seconds before the dump,
+encoder position, status code, operation (0 - idle, 1 - opening, 2 - closing).
+The format is described at MotionTrace in components/bus_t4/nice-bust4.h.
+"""
+import base64
+import sys
+
+TRACE_VERSION = 1
+TRACE_STATUS = 0x01
+TRACE_POSITION = 0x02
+OPERATIONS = {0: 'idle', 1: 'opening', 2: 'closing'}
+
+
+def varint(data, pos):
+    value = 0
+    shift = 0
+    while True:
+        byte = data[pos]
+        pos += 1
+        value |= (byte & 0x7F) << shift
+        shift += 7
+        if byte < 0x80:
+            return value, pos
+
+
+def maneuver(data):
+    start, pos = varint(data, 0)
+    position, pos = varint(data, pos)
+    operation = data[pos]
+    pos += 1
+    time = start
+    status = None
+    yield start, position, status, operation
+    while pos < len(data):
+        value, pos = varint(data, pos)
+        time += value >> 2
+        if value & TRACE_STATUS:
+            status, operation = data[pos], data[pos + 1]
+            pos += 2
+        if value & TRACE_POSITION:
+            delta, pos = varint(data, pos)
+            position += (delta >> 1) ^ -(delta & 1)
+        yield time, position, status, operation
+
+
+def decode(text):
+    data = base64.b64decode(''.join(text.split()))
+    if data[0] != TRACE_VERSION:
+        raise ValueError('unknown trace version %d' % data[0])
+    now, pos = varint(data, 1)
+    count = data[pos]
+    pos += 1
+    print('maneuver,time_ms,age_s,position,status,operation')
+    for number in range(count):
+        length, pos = varint(data, pos)
+        start = None
+        for time, position, status, operation in maneuver(data[pos:pos + length]):
+            start = time if start is None else start
+            print('%d,%d,%.1f,%d,%s,%s' % (number, time - start, ((now - time) & 0xFFFFFFFF) / 1000.0, position,
+                                           '' if status is None else '0x%02X' % status,
+                                           OPERATIONS.get(operation, operation)))
+        pos += length
+
+
+if __name__ == '__main__':
+    decode(sys.argv[1] if len(sys.argv) > 1 else sys.stdin.read())